@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+"""Optimize a panel SVG saved by Inkscape for loading in Rack.
+
+Usage: optimize_panel.py SOURCE.svg DESTINATION.svg
+
+- Text is converted to paths (with Inkscape, only if some text is left).
+- Hidden layers (such as "components"), empty texts, editor metadata and
+  editor-only attributes are removed.
+- Unreferenced ids and definitions are removed.
+- Coordinates are rounded to 3 decimals, transforms to 6.
+"""
+
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import xml.etree.ElementTree as ET
+
+SVG = "http://www.w3.org/2000/svg"
+XLINK = "http://www.w3.org/1999/xlink"
+EDITOR_NAMESPACES = (
+    "http://www.inkscape.org/namespaces/inkscape",
+    "http://sodipodi.sourceforge.net/DTD/sodipodi-0.dtd",
+    "http://www.openswatchbook.org/uri/2009/osb",
+    "http://purl.org/dc/elements/1.1/",
+    "http://creativecommons.org/ns#",
+    "http://www.w3.org/1999/02/22-rdf-syntax-ns#",
+)
+# Style properties that nanosvg never reads.
+USELESS_STYLE = (
+    "font-", "line-height", "letter-spacing", "word-spacing",
+    "-inkscape-", "enable-background", "marker", "paint-order",
+    "stroke-dasharray:none", "stroke-dashoffset",
+)
+NUMBER = re.compile(r"-?(?:\d+\.?\d*|\.\d+)(?:[eE][-+]?\d+)?")
+PRECISION = 3
+
+
+def tag(element):
+    return element.tag.split("}")[-1]
+
+
+def namespace(name):
+    return name[1:].split("}")[0] if name.startswith("{") else None
+
+
+def round_numbers(text, precision=PRECISION):
+    def rounded(match):
+        value = round(float(match.group(0)), precision)
+        if value == int(value):
+            return " %d" % value
+        return " " + ("%.*f" % (precision, value)).rstrip("0")
+    text = NUMBER.sub(rounded, text)
+    text = re.sub(r"\s+", " ", text)
+    text = re.sub(r"\s*,\s*", ",", text)
+    text = re.sub(r"([a-zA-Z(]) ", r"\1", text)
+    return text.strip()
+
+
+def clean_style(style):
+    declarations = []
+    for declaration in style.split(";"):
+        declaration = declaration.strip()
+        if not declaration or declaration.startswith(USELESS_STYLE):
+            continue
+        declarations.append(declaration)
+    return ";".join(declarations)
+
+
+def is_hidden(element):
+    style = element.get("style", "").replace(" ", "")
+    return "display:none" in style or element.get("display") == "none"
+
+
+def is_empty_text(element):
+    return tag(element) == "text" and not "".join(element.itertext()).strip()
+
+
+def prune(parent):
+    for child in list(parent):
+        if namespace(child.tag) in EDITOR_NAMESPACES or tag(child) == "metadata" \
+                or is_hidden(child) or is_empty_text(child):
+            parent.remove(child)
+        else:
+            prune(child)
+
+
+def clean_attributes(root):
+    for element in root.iter():
+        for name in list(element.attrib):
+            if namespace(name) in EDITOR_NAMESPACES:
+                del element.attrib[name]
+            elif name in ("d", "points", "viewBox"):
+                element.set(name, round_numbers(element.get(name)))
+            elif name in ("transform", "gradientTransform"):
+                # Scale factors need more than the coordinates.
+                element.set(name, round_numbers(element.get(name), 6))
+            elif name in ("x", "y", "x1", "y1", "x2", "y2", "cx", "cy", "r",
+                          "rx", "ry", "width", "height", "fx", "fy"):
+                value = element.get(name)
+                if NUMBER.fullmatch(value):
+                    element.set(name, round_numbers(value))
+            elif name == "style":
+                style = clean_style(element.get(name))
+                if style:
+                    element.set(name, style)
+                else:
+                    del element.attrib[name]
+
+
+def referenced_ids(root):
+    ids = set()
+    for element in root.iter():
+        for name, value in element.attrib.items():
+            ids.update(re.findall(r"url\(#([^)]+)\)", value))
+            if name in ("href", "{%s}href" % XLINK) and value.startswith("#"):
+                ids.add(value[1:])
+    return ids
+
+
+def remove_unused(root):
+    # Removing a definition can orphan another (gradient stops are linked
+    # with xlink:href), so go on until nothing changes.
+    while True:
+        used = referenced_ids(root)
+        removed = False
+        for defs in root.iter("{%s}defs" % SVG):
+            for child in list(defs):
+                if child.get("id") not in used:
+                    defs.remove(child)
+                    removed = True
+        if not removed:
+            break
+    for defs in list(root.iter("{%s}defs" % SVG)):
+        if len(defs) == 0:
+            root.remove(defs)
+    for element in root.iter():
+        if element is not root and element.get("id") not in used:
+            element.attrib.pop("id", None)
+
+
+def texts_to_paths(source):
+    tree = ET.parse(source)
+    if not any(tag(e) == "text" and not is_empty_text(e) for e in tree.iter()):
+        return source
+    inkscape = shutil.which("inkscape")
+    if not inkscape:
+        sys.exit("%s has text, Inkscape is needed to convert it to paths" % source)
+    destination = tempfile.NamedTemporaryFile(suffix=".svg", delete=False).name
+    subprocess.check_call([inkscape, source, "--export-text-to-path",
+                           "--export-plain-svg", "--export-filename", destination])
+    return destination
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    source, destination = sys.argv[1:]
+
+    ET.register_namespace("", SVG)
+    ET.register_namespace("xlink", XLINK)
+    tree = ET.parse(texts_to_paths(source))
+    root = tree.getroot()
+    prune(root)
+    clean_attributes(root)
+    remove_unused(root)
+    tree.write(destination, encoding="UTF-8", xml_declaration=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,255 +1,21 @@
-#include "plugin.hpp"
+#include "DoubleMute.hpp"
+#include "StateTraceMenu.hpp"
 
-struct DoubleMute : Module {
-
-    const float PRESET_FADE = 0.1;
-
-    enum ParamIds {
-        MUTE_PARAM,
-        FADE_IN_PARAM,
-        FADE_OUT_PARAM,
-        SCALE_IN_PARAM,
-        SCALE_OUT_PARAM,
-        NUM_PARAMS
-    };
-    enum InputIds {
-        IN1_INPUT,
-        IN2_INPUT,
-        TRIGGER_MUTE_INPUT,
-        NUM_INPUTS
+static std::string describeDoubleMuteEvent(const StateTraceEvent& event) {
+    static const char* const states[] = {
+        "playing", "muted", "fading in", "fading out"
     };
-    enum OutputIds {
-        OUT1_OUTPUT,
-        OUT2_OUTPUT,
-        NUM_OUTPUTS
+    static const char* const causes[] = {
+        "button", "trigger input", "end of the fade", "leader"
     };
-    enum LightIds {
-        MUTE_LIGHT,
-        RAMP_UP_LIGHT,
-        RAMP_DOWN_LIGHT,
-        NUM_LIGHTS
-    };
-
-    enum States {
-        HIGH,
-        LOW,
-        RAMP_UP,
-        RAMP_DOWN
-    };
-
-    States state;
-    dsp::BooleanTrigger muteTrigger;
-    float fadeTimeEllapsed;
-    bool exponentialFade = true; // If not it's linear.
-
-    DoubleMute() {
-        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
-        configParam(MUTE_PARAM, 0.0, 1.0, 0.0, "Mute channels");
-        configParam(FADE_IN_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-in time");
-        configParam(FADE_OUT_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-out time");
-        configParam(SCALE_IN_PARAM, 0.0, 2.0, 0.0, "Fade-in scale");
-        configParam(SCALE_OUT_PARAM, 0.0, 2.0, 0.0, "Fade-out scale");
-
-        onReset();
-    }
-
-    void onReset() override {
-        lights[RAMP_UP_LIGHT].setBrightness(0.f);
-        lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
-    }
-
-    void process(const ProcessArgs& args) override {
-        setState();
-
-        switch(state) {
-            case HIGH:
-                lights[MUTE_LIGHT].setBrightness(0.9f);
-                high();
-                break;
-            case RAMP_UP:
-                rampUp(args.sampleTime);
-                break;
-            case RAMP_DOWN:
-                rampDown(args.sampleTime);
-                break;
-            case LOW:
-            default:
-                break;
-        }
-    }
-
-    void setState() {
-        if (muteTrigger.process(params[MUTE_PARAM].getValue() > 0.f)
-                || inputs[TRIGGER_MUTE_INPUT].getNormalVoltage(0.f) > 0.f) {
-            switch(state) {
-                case HIGH:
-                    state = RAMP_DOWN;
-                    fadeTimeEllapsed = rampDownTime();
-                    lights[MUTE_LIGHT].setBrightness(0.f);
-                    lights[RAMP_DOWN_LIGHT].setBrightness(0.9f);
-                    lights[RAMP_UP_LIGHT].setBrightness(0.f);
-                    break;
-                case RAMP_UP:
-                    state = RAMP_DOWN;
-                    fadeTimeEllapsed = rampUpToDownTime();
-                    lights[MUTE_LIGHT].setBrightness(0.f);
-                    lights[RAMP_DOWN_LIGHT].setBrightness(0.9f);
-                    lights[RAMP_UP_LIGHT].setBrightness(0.f);
-                    break;
-                case RAMP_DOWN:
-                    state = RAMP_UP;
-                    fadeTimeEllapsed = rampDownToUpTime();
-                    lights[MUTE_LIGHT].setBrightness(0.9f);
-                    lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
-                    lights[RAMP_UP_LIGHT].setBrightness(0.9f);
-                    break;
-                case LOW:
-                default:
-                    state = RAMP_UP;
-                    fadeTimeEllapsed = 0.f;
-                    lights[MUTE_LIGHT].setBrightness(0.9f);
-                    lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
-                    lights[RAMP_UP_LIGHT].setBrightness(0.9f);
-                    break;
-            }
-        }
-    }
-
-    float rampUpToDownTime() {
-        float ratio = fadeTimeEllapsed / rampUpTime();
-        return rampDownTime() * ratio;
-    }
-
-    float rampDownToUpTime() {
-        float ratio = fadeTimeEllapsed / rampDownTime();
-        return rampUpTime() * ratio;
-    }
-
-    float rampDownTime() {
-        float time = params[FADE_OUT_PARAM].getValue();
-        int mult = (int) std::round(params[SCALE_OUT_PARAM].getValue());
-        switch(mult) {
-            case 1:
-                time *= 10;
-                break;
-            case 2:
-                time *= 100;
-                break;
-            default:
-                break;
-        }
-        return time;
-    }
-
-    float rampUpTime() {
-        float time = params[FADE_IN_PARAM].getValue();
-        int mult = (int) std::round(params[SCALE_IN_PARAM].getValue());
-        switch(mult) {
-            case 1:
-                time *= 10;
-                break;
-            case 2:
-                time *= 100;
-                break;
-            default:
-                break;
-        }
-        return time;
-    }
-
-    void rampUp(float sampleTime) {
-        fadeTimeEllapsed += sampleTime;
-        float userValue = rampUpTime();
-        float mult = fadeTimeEllapsed / userValue;
-        mult = clamp(mult, 0.f, 1.f);
-
-        if (exponentialFade) {
-            mult = rescale(std::pow(50.f, mult), 1.f, 50.f, 0.f, 1.f);
-        }
-
-        if (inputs[IN1_INPUT].isConnected() && outputs[OUT1_OUTPUT].isConnected()) {
-            outputs[OUT1_OUTPUT].setVoltage(inputs[IN1_INPUT].getVoltage() * mult);
-        }
-        if (inputs[IN2_INPUT].isConnected() && outputs[OUT2_OUTPUT].isConnected()) {
-            outputs[OUT2_OUTPUT].setVoltage(inputs[IN2_INPUT].getVoltage() * mult);
-        }
-        if (fadeTimeEllapsed >= userValue) {
-            state = HIGH;
-            lights[RAMP_UP_LIGHT].setBrightness(0.f);
-        } else {
-            lights[RAMP_UP_LIGHT].setBrightness(1.f - (mult));
-        }
-    }
-
-    void high() {
-        if (inputs[IN1_INPUT].isConnected() && outputs[OUT1_OUTPUT].isConnected()) {
-            outputs[OUT1_OUTPUT].setVoltage(inputs[IN1_INPUT].getVoltage());
-        }
-        if (inputs[IN2_INPUT].isConnected() && outputs[OUT2_OUTPUT].isConnected()) {
-            outputs[OUT2_OUTPUT].setVoltage(inputs[IN2_INPUT].getVoltage());
-        }
-    }
-
-    void rampDown(float sampleTime) {
-        fadeTimeEllapsed -= sampleTime;
-        float userValue = rampDownTime();
-        float mult = fadeTimeEllapsed / userValue;
-        mult = clamp(mult, 0.f, 1.f);
-
-        if (exponentialFade) {
-            mult = rescale(std::pow(50.f, mult), 1.f, 50.f, 0.f, 1.f);
-        }
-
-        if (inputs[IN1_INPUT].isConnected() && outputs[OUT1_OUTPUT].isConnected()) {
-            outputs[OUT1_OUTPUT].setVoltage(inputs[IN1_INPUT].getVoltage() * mult);
-        }
-        if (inputs[IN2_INPUT].isConnected() && outputs[OUT2_OUTPUT].isConnected()) {
-            outputs[OUT2_OUTPUT].setVoltage(inputs[IN2_INPUT].getVoltage() * mult);
-        }
-        if (fadeTimeEllapsed <= 0.f) {
-            state = LOW;
-            lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
-        } else {
-            lights[RAMP_DOWN_LIGHT].setBrightness(mult);
-        }
-    }
-
-    json_t *dataToJson() override {
-        float value;
-        value = (state == HIGH || state == RAMP_UP) ? 1 : 0;
-        json_t *rootJ = json_object();
-        json_object_set_new(rootJ, "state", json_integer(value));
-        json_object_set_new(rootJ, "exponentialFade", json_integer((int) exponentialFade));
-        return rootJ;
-    }
-
-    void dataFromJson(json_t *rootJ) override {
-        json_t *stateJ = json_object_get(rootJ, "state");
-        if (stateJ) {
-            float value = json_integer_value(stateJ);
-            if (value == 1) {
-                state = HIGH;
-            } else {
-                state = LOW;
-            }
-        }
-
-        json_t *exponentialFadeJ = json_object_get(rootJ, "exponentialFade");
-        if (exponentialFadeJ) {
-            exponentialFade = json_integer_value(exponentialFadeJ);
-        }
-    }
-};
-
-template <typename BASE>
-struct MuteLight : BASE {
-    MuteLight() {
-        this->box.size = mm2px(Vec(6.f, 6.f));
-    }
-};
+    return string::f("%s -> %s (%s)", stateTraceName(states, event.from),
+                     stateTraceName(states, event.to),
+                     stateTraceName(causes, event.cause));
+}
 
 struct DoubleMuteWidget : ModuleWidget {
     DoubleMuteWidget(DoubleMute* module) {
+        PanelTimer timer("DoubleMute");
         setModule(module);
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/DoubleMute.svg")));
 
@@ -282,6 +48,8 @@ struct DoubleMuteWidget : ModuleWidget {
                     module, DoubleMute::OUT1_OUTPUT));
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(22.86, 42.0)),
                     module, DoubleMute::OUT2_OUTPUT));
+        addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(6.35, 81.0)),
+                    module, DoubleMute::ENV_OUTPUT));
 
         addChild(createLightCentered<MuteLight<GreenLight>>(mm2px(Vec(15.24, 32.0)),
                     module, DoubleMute::MUTE_LIGHT));
@@ -302,6 +70,16 @@ struct DoubleMuteWidget : ModuleWidget {
         }
     };
 
+    struct DoubleMuteLinkItem : MenuItem {
+        DoubleMute *module;
+        void onAction(const event::Action &e) override {
+            module->linked ^= true;
+        }
+        void step() override {
+            rightText = module->linked ? "✔" : "";
+        }
+    };
+
     void appendContextMenu(Menu *menu) override {
         MenuLabel *spacerLabel = new MenuLabel();
         menu->addChild(spacerLabel);
@@ -324,6 +102,18 @@ struct DoubleMuteWidget : ModuleWidget {
         item2->module = module;
         item2->mode = false;
         menu->addChild(item2);
+
+        menu->addChild(new MenuLabel());
+
+        DoubleMuteLinkItem *linkItem = new DoubleMuteLinkItem();
+        linkItem->text = "Follow the Double Mute on the left";
+        linkItem->module = module;
+        menu->addChild(linkItem);
+
+        menu->addChild(new MenuLabel());
+
+        appendStateTraceMenu(menu, &module->trace, describeDoubleMuteEvent,
+                             "Double Mute");
     }
 
 };
@@ -0,0 +1,368 @@
+#pragma once
+#include "plugin.hpp"
+#include "StateTrace.hpp"
+#include "Tables.hpp"
+
+// What the leader of a linked group sends to each follower, once per frame,
+// through the follower's left expander.
+struct alignas(CACHE_LINE) DoubleMuteLink {
+    bool fresh = false;
+    int state;
+    float fadeTimeEllapsed;
+    float gain;
+    float lights[3];
+};
+
+struct DoubleMute : Module, CacheAligned {
+
+    const float PRESET_FADE = 0.1;
+
+    enum ParamIds {
+        MUTE_PARAM,
+        FADE_IN_PARAM,
+        FADE_OUT_PARAM,
+        SCALE_IN_PARAM,
+        SCALE_OUT_PARAM,
+        NUM_PARAMS
+    };
+    enum InputIds {
+        IN1_INPUT,
+        IN2_INPUT,
+        TRIGGER_MUTE_INPUT,
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        OUT1_OUTPUT,
+        OUT2_OUTPUT,
+        ENV_OUTPUT,
+        NUM_OUTPUTS
+    };
+    enum LightIds {
+        MUTE_LIGHT,
+        RAMP_UP_LIGHT,
+        RAMP_DOWN_LIGHT,
+        NUM_LIGHTS
+    };
+
+    enum States {
+        HIGH,
+        LOW,
+        RAMP_UP,
+        RAMP_DOWN
+    };
+
+    // What changed the state, in the trace.
+    enum TraceCauses {
+        BUTTON_CAUSE,
+        TRIGGER_CAUSE,
+        FADE_END_CAUSE,
+        LEADER_CAUSE
+    };
+
+    // Audio thread state, on its own cache line.
+    alignas(CACHE_LINE) States state;
+    dsp::BooleanTrigger muteTrigger;
+    float fadeTimeEllapsed;
+    float linkGain = 0.f;
+    const CurveTable* fadeTable; // Shared, see Tables.hpp.
+
+    // Set from the context menu.
+    alignas(CACHE_LINE) bool exponentialFade = true; // If not it's linear.
+    bool linked = false; // Follow the Double Mute on the left.
+
+    // Left expander buffers, written by the leader of the group.
+    DoubleMuteLink linkMessages[2];
+
+    // The last state changes, for the context menu.
+    StateTrace trace;
+
+    DoubleMute() {
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        configParam(MUTE_PARAM, 0.0, 1.0, 0.0, "Mute channels");
+        configParam(FADE_IN_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-in time");
+        configParam(FADE_OUT_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-out time");
+        configParam(SCALE_IN_PARAM, 0.0, 2.0, 0.0, "Fade-in scale");
+        configParam(SCALE_OUT_PARAM, 0.0, 2.0, 0.0, "Fade-out scale");
+
+        leftExpander.producerMessage = &linkMessages[0];
+        leftExpander.consumerMessage = &linkMessages[1];
+
+        fadeTable = &exponentialFadeTable();
+        state = HIGH;
+        fadeTimeEllapsed = 0.f;
+
+        onReset();
+    }
+
+    void onReset() override {
+        lights[RAMP_UP_LIGHT].setBrightness(0.f);
+        lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
+    }
+
+    void process(const ProcessArgs& args) override {
+        trace.tick(args.sampleTime);
+
+        if (followLeader()) {
+            return;
+        }
+
+        setState();
+
+        float gain = 0.f;
+        switch(state) {
+            case HIGH:
+                lights[MUTE_LIGHT].setBrightness(0.9f);
+                gain = 1.f;
+                break;
+            case RAMP_UP:
+                gain = rampUp(args.sampleTime);
+                break;
+            case RAMP_DOWN:
+                gain = rampDown(args.sampleTime);
+                break;
+            case LOW:
+            default:
+                break;
+        }
+
+        // The followers get the gain of this frame on the next one. So does
+        // the leader, to stay sample-locked with them.
+        if (broadcast(gain)) {
+            std::swap(gain, linkGain);
+        } else {
+            linkGain = gain;
+        }
+        applyGain(gain);
+    }
+
+    // A group is a row of adjacent Double Mutes, each one but the first
+    // (the leader) linked to its left neighbour from the context menu. The
+    // leader runs the fades and sends its state and gain straight to every
+    // follower's buffer, so they all apply it on the same frame.
+    bool broadcast(float gain) {
+        bool followed = false;
+        DoubleMute* follower = dynamic_cast<DoubleMute*>(rightExpander.module);
+        while (follower && follower->linked) {
+            DoubleMuteLink* link = (DoubleMuteLink*) follower->leftExpander.producerMessage;
+            link->fresh = true;
+            link->state = state;
+            link->fadeTimeEllapsed = fadeTimeEllapsed;
+            link->gain = gain;
+            for (int i = 0; i < NUM_LIGHTS; i++) {
+                link->lights[i] = lights[i].getBrightness();
+            }
+            follower->leftExpander.messageFlipRequested = true;
+            followed = true;
+            follower = dynamic_cast<DoubleMute*>(follower->rightExpander.module);
+        }
+        return followed;
+    }
+
+    // A follower plays the gain of its leader and ignores its own button,
+    // trigger input and knobs. Returns false when not following. Until the
+    // first message arrives, it holds its last gain.
+    bool followLeader() {
+        if (!linked || !dynamic_cast<DoubleMute*>(leftExpander.module)) {
+            return false;
+        }
+        DoubleMuteLink* link = (DoubleMuteLink*) leftExpander.consumerMessage;
+        if (!link->fresh) {
+            applyGain(linkGain);
+            return true;
+        }
+        link->fresh = false;
+
+        // Keep the state, to carry on from there if unlinked.
+        if (link->state != state) {
+            trace.record(state, link->state, LEADER_CAUSE);
+        }
+        state = (States) link->state;
+        fadeTimeEllapsed = link->fadeTimeEllapsed;
+        muteTrigger.process(params[MUTE_PARAM].getValue() > 0.f);
+        for (int i = 0; i < NUM_LIGHTS; i++) {
+            lights[i].setBrightness(link->lights[i]);
+        }
+        linkGain = link->gain;
+        applyGain(link->gain);
+        return true;
+    }
+
+    // Also sends the gain to the envelope output, 10 V being unity, on as
+    // many channels as the widest input, for polyphonic VCAs.
+    void applyGain(float gain) {
+        if (inputs[IN1_INPUT].isConnected() && outputs[OUT1_OUTPUT].isConnected()) {
+            outputs[OUT1_OUTPUT].setVoltage(inputs[IN1_INPUT].getVoltage() * gain);
+        }
+        if (inputs[IN2_INPUT].isConnected() && outputs[OUT2_OUTPUT].isConnected()) {
+            outputs[OUT2_OUTPUT].setVoltage(inputs[IN2_INPUT].getVoltage() * gain);
+        }
+        Output& envelope = outputs[ENV_OUTPUT];
+        if (envelope.isConnected()) {
+            int channels = std::max(1, std::max(inputs[IN1_INPUT].getChannels(),
+                                                inputs[IN2_INPUT].getChannels()));
+            envelope.setChannels(channels);
+            for (int c = 0; c < channels; c++) {
+                envelope.setVoltage(10.f * gain, c);
+            }
+        }
+    }
+
+    void setState() {
+        TraceCauses cause;
+        if (muteTrigger.process(params[MUTE_PARAM].getValue() > 0.f)) {
+            cause = BUTTON_CAUSE;
+        } else if (inputs[TRIGGER_MUTE_INPUT].getNormalVoltage(0.f) > 0.f) {
+            cause = TRIGGER_CAUSE;
+        } else {
+            return;
+        }
+
+        States from = state;
+        switch(state) {
+            case HIGH:
+                state = RAMP_DOWN;
+                fadeTimeEllapsed = rampDownTime();
+                lights[MUTE_LIGHT].setBrightness(0.f);
+                lights[RAMP_DOWN_LIGHT].setBrightness(0.9f);
+                lights[RAMP_UP_LIGHT].setBrightness(0.f);
+                break;
+            case RAMP_UP:
+                state = RAMP_DOWN;
+                fadeTimeEllapsed = rampUpToDownTime();
+                lights[MUTE_LIGHT].setBrightness(0.f);
+                lights[RAMP_DOWN_LIGHT].setBrightness(0.9f);
+                lights[RAMP_UP_LIGHT].setBrightness(0.f);
+                break;
+            case RAMP_DOWN:
+                state = RAMP_UP;
+                fadeTimeEllapsed = rampDownToUpTime();
+                lights[MUTE_LIGHT].setBrightness(0.9f);
+                lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
+                lights[RAMP_UP_LIGHT].setBrightness(0.9f);
+                break;
+            case LOW:
+            default:
+                state = RAMP_UP;
+                fadeTimeEllapsed = 0.f;
+                lights[MUTE_LIGHT].setBrightness(0.9f);
+                lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
+                lights[RAMP_UP_LIGHT].setBrightness(0.9f);
+                break;
+        }
+        trace.record(from, state, cause);
+    }
+
+    float rampUpToDownTime() {
+        float ratio = fadeTimeEllapsed / rampUpTime();
+        return rampDownTime() * ratio;
+    }
+
+    float rampDownToUpTime() {
+        float ratio = fadeTimeEllapsed / rampDownTime();
+        return rampUpTime() * ratio;
+    }
+
+    float rampDownTime() {
+        float time = params[FADE_OUT_PARAM].getValue();
+        int mult = (int) std::round(params[SCALE_OUT_PARAM].getValue());
+        switch(mult) {
+            case 1:
+                time *= 10;
+                break;
+            case 2:
+                time *= 100;
+                break;
+            default:
+                break;
+        }
+        return time;
+    }
+
+    float rampUpTime() {
+        float time = params[FADE_IN_PARAM].getValue();
+        int mult = (int) std::round(params[SCALE_IN_PARAM].getValue());
+        switch(mult) {
+            case 1:
+                time *= 10;
+                break;
+            case 2:
+                time *= 100;
+                break;
+            default:
+                break;
+        }
+        return time;
+    }
+
+    float rampUp(float sampleTime) {
+        fadeTimeEllapsed += sampleTime;
+        float userValue = rampUpTime();
+        float mult = fadeTimeEllapsed / userValue;
+        mult = clamp(mult, 0.f, 1.f);
+
+        if (exponentialFade) {
+            mult = (*fadeTable)(mult);
+        }
+
+        if (fadeTimeEllapsed >= userValue) {
+            trace.record(state, HIGH, FADE_END_CAUSE);
+            state = HIGH;
+            lights[RAMP_UP_LIGHT].setBrightness(0.f);
+        } else {
+            lights[RAMP_UP_LIGHT].setBrightness(1.f - (mult));
+        }
+        return mult;
+    }
+
+    float rampDown(float sampleTime) {
+        fadeTimeEllapsed -= sampleTime;
+        float userValue = rampDownTime();
+        float mult = fadeTimeEllapsed / userValue;
+        mult = clamp(mult, 0.f, 1.f);
+
+        if (exponentialFade) {
+            mult = (*fadeTable)(mult);
+        }
+
+        if (fadeTimeEllapsed <= 0.f) {
+            trace.record(state, LOW, FADE_END_CAUSE);
+            state = LOW;
+            lights[RAMP_DOWN_LIGHT].setBrightness(0.f);
+        } else {
+            lights[RAMP_DOWN_LIGHT].setBrightness(mult);
+        }
+        return mult;
+    }
+
+    json_t *dataToJson() override {
+        float value;
+        value = (state == HIGH || state == RAMP_UP) ? 1 : 0;
+        json_t *rootJ = json_object();
+        json_object_set_new(rootJ, "state", json_integer(value));
+        json_object_set_new(rootJ, "exponentialFade", json_integer((int) exponentialFade));
+        json_object_set_new(rootJ, "linked", json_boolean(linked));
+        return rootJ;
+    }
+
+    void dataFromJson(json_t *rootJ) override {
+        json_t *stateJ = json_object_get(rootJ, "state");
+        if (stateJ) {
+            float value = json_integer_value(stateJ);
+            if (value == 1) {
+                state = HIGH;
+            } else {
+                state = LOW;
+            }
+        }
+
+        json_t *exponentialFadeJ = json_object_get(rootJ, "exponentialFade");
+        if (exponentialFadeJ) {
+            exponentialFade = json_integer_value(exponentialFadeJ);
+        }
+
+        json_t *linkedJ = json_object_get(rootJ, "linked");
+        if (linkedJ) {
+            linked = json_boolean_value(linkedJ);
+        }
+    }
+};
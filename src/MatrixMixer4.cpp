@@ -1,296 +1,238 @@
-#include "plugin.hpp"
+#include "MatrixMixer4.hpp"
+#include "StateTraceMenu.hpp"
+
+// The potentiometers are shown as a hexadecimal led mask, one digit per row
+// (the last one is row 1), one bit per column.
+static std::string describeMatrixMixer4Event(const StateTraceEvent& event) {
+    if (event.cause >= MatrixMixer4::ALGO_BUTTON_CAUSE) {
+        const MuteAlgorithm& from =
+            MUTE_ALGORITHMS[clamp(event.from, 1, NUM_MUTE_ALGORITHMS) - 1];
+        const MuteAlgorithm& to =
+            MUTE_ALGORITHMS[clamp(event.to, 1, NUM_MUTE_ALGORITHMS) - 1];
+        static const char* const causes[] = {"button", "CV", "menu"};
+        return string::f("mute algorithm %s -> %s (%s)", from.name, to.name,
+                         stateTraceName(causes, event.cause -
+                                        MatrixMixer4::ALGO_BUTTON_CAUSE));
+    }
+    int kind = event.cause / 4;
+    return string::f("%s %d toggled, potentiometers %04X -> %04X (%s)",
+                     (kind < 2) ? "row" : "column", event.cause % 4 + 1,
+                     event.from, event.to, (kind % 2) ? "CV" : "button");
+}
+
+// All 8 level meters, drawn by a single widget as small horizontal bars
+// by the jacks: RMS is the filled part, peak is the tick.
+struct MatrixMixer4MeterDisplay : TransparentWidget {
+    MatrixMixer4* module = NULL;
+
+    void drawBar(NVGcontext* vg, Vec center, float rms, float peak) {
+        Vec pos = mm2px(Vec(center.x - 4.5f, center.y));
+        Vec size = mm2px(Vec(9.f, 1.f));
+        float rmsWidth = size.x * clamp(rms / 10.f, 0.f, 1.f);
+        float peakX = pos.x + size.x * clamp(peak / 10.f, 0.f, 1.f);
+
+        nvgBeginPath(vg);
+        nvgRect(vg, pos.x, pos.y, size.x, size.y);
+        nvgFillColor(vg, nvgRGBA(0x30, 0x30, 0x30, 0xff));
+        nvgFill(vg);
+
+        nvgBeginPath(vg);
+        nvgRect(vg, pos.x, pos.y, rmsWidth, size.y);
+        nvgFillColor(vg, nvgRGBA(0x6e, 0xc0, 0x2c, 0xff));
+        nvgFill(vg);
+
+        nvgBeginPath(vg);
+        nvgRect(vg, peakX - 1.f, pos.y, 1.f, size.y);
+        nvgFillColor(vg, (peak > 5.f) ? nvgRGBA(0xe0, 0x3c, 0x31, 0xff)
+                                      : nvgRGBA(0xf4, 0xe8, 0x3a, 0xff));
+        nvgFill(vg);
+    }
 
-struct MatrixMixer4 : Module {
+    void draw(const DrawArgs& args) override {
+        if (!module) {
+            return;
+        }
 
-    enum ParamIds {
-        ENUMS(POT_PARAMS, 16),
-        ENUMS(ROW_PARAMS, 4),
-        ENUMS(COL_PARAMS, 4),
-        MUTE_ALGO_PARAM,
-        NUM_PARAMS
-    };
+        MatrixMixer4Meters meters = module->getMeters();
+        for (int i = 0; i < 4; i++) {
+            drawBar(args.vg, Vec(27.5f + 16.67f * i, 24.5f),
+                    meters.inRms[i], meters.inPeak[i]);
+            drawBar(args.vg, Vec(93.6f, 29.5f + 18.67f * i),
+                    meters.outRms[i], meters.outPeak[i]);
+        }
+    }
+};
 
-    enum InputIds {
-        ENUMS(IN_INPUTS, 4),
-        ENUMS(ROW_CV_INPUTS, 4),
-        ENUMS(COL_CV_INPUTS, 4),
-        ALGO_CV_INPUT,
-        NUM_INPUTS
-    };
+// A regular knob for the mouse (dragging, context menu, undo...) whose face
+// and shadow MatrixMixer4Grid draws. It only draws what ParamWidget::draw
+// adds on top: the square of the MIDI map holding it, if any.
+struct MatrixMixer4Knob : RoundBlackKnob {
+    void draw(const DrawArgs& args) override {
+        engine::ParamHandle* paramHandle = paramQuantity ?
+            APP->engine->getParamHandle(paramQuantity->module->id,
+                                        paramQuantity->paramId) : NULL;
+        if (!paramHandle) {
+            return;
+        }
+        const float size = 6.f;
+        nvgBeginPath(args.vg);
+        nvgRect(args.vg, box.size.x - size, box.size.y - size, size, size);
+        nvgFillColor(args.vg, paramHandle->color);
+        nvgFill(args.vg);
+        nvgStrokeColor(args.vg, color::mult(paramHandle->color, 0.5f));
+        nvgStrokeWidth(args.vg, 1.f);
+        nvgStroke(args.vg);
+    }
+};
 
-    enum OutputIds {
-        ENUMS(OUT_OUTPUTS, 4),
-        NUM_OUTPUTS
-    };
+// Draws the 16 knob faces with their shadows and the 28 LEDs at once, inside
+// a framebuffer which is only rendered again when a knob or a LED has
+// changed.
+struct MatrixMixer4Grid : FramebufferWidget {
 
-    enum LightIds {
-        ENUMS(SMALL_LEDS, 16),
-        ENUMS(ROW_LEDS, 4),
-        ENUMS(COL_LEDS, 4),
-        ENUMS(ALGO_LEDS, 4),
-        NUM_LIGHTS
+    struct Drawing : TransparentWidget {
+        MatrixMixer4Grid* grid;
+        void draw(const DrawArgs& args) override {
+            grid->drawGrid(args.vg);
+        }
     };
 
-    // Amplitude algorithm:
-    //   0 - Ducking (the more voices in a row, the less amplitude per voice)
-    //   1 - Hard clipping 10 Vpp
-    //   2 - No processing
-    int amplitudeAlgorithm = 0;
-
-    // Mute algorithm (do not use 0):
-    //   0 - I repeat, DO NOT USE 0!
-    //   1 - Force (default)
-    //   2 - Flip-flop (it's like XOR)
-    //   3 - Intersections (it's like AND)
-    int muteAlgorithm = 1;
-
-    dsp::BooleanTrigger rowTrigger[4];
-    dsp::BooleanTrigger colTrigger[4];
-    dsp::BooleanTrigger algoTrigger;
-    bool ledMatrix[16];
-    bool rowState[4];
-    bool colState[4];
-
-    void onAdd() override {
-    }
+    static constexpr float KNOB_MIN_ANGLE = -0.83 * M_PI;
+    static constexpr float KNOB_MAX_ANGLE = 0.83 * M_PI;
 
-    void onReset() override {
-        reset();
-    }
+    MatrixMixer4* module;
+    std::shared_ptr<Svg> knobSvg;
+    float knobs[16];
+    float leds[MatrixMixer4::NUM_LIGHTS];
 
-    void reset() {
+    MatrixMixer4Grid(MatrixMixer4* module) {
+        this->module = module;
+        knobSvg = APP->window->loadSvg(asset::system("res/ComponentLibrary/RoundBlackKnob.svg"));
         for (int i = 0; i < 16; i++) {
-            ledMatrix[i] = true;
+            knobs[i] = 0.5f;
         }
-        for (int i = 0; i < 4; i++) {
-            rowState[i] = true;
-            colState[i] = true;
+        for (int i = 0; i < MatrixMixer4::NUM_LIGHTS; i++) {
+            leds[i] = 0.f;
         }
-    }
 
-    MatrixMixer4() {
-        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
-        configParam(POT_PARAMS + 0, 0.f, 1.f, 0.5f, "Row 1 Col 1");
-        configParam(POT_PARAMS + 1, 0.f, 1.f, 0.5f, "Row 1 Col 2");
-        configParam(POT_PARAMS + 2, 0.f, 1.f, 0.5f, "Row 1 Col 3");
-        configParam(POT_PARAMS + 3, 0.f, 1.f, 0.5f, "Row 1 Col 4");
-        configParam(POT_PARAMS + 4, 0.f, 1.f, 0.5f, "Row 2 Col 1");
-        configParam(POT_PARAMS + 5, 0.f, 1.f, 0.5f, "Row 2 Col 2");
-        configParam(POT_PARAMS + 6, 0.f, 1.f, 0.5f, "Row 2 Col 3");
-        configParam(POT_PARAMS + 7, 0.f, 1.f, 0.5f, "Row 2 Col 4");
-        configParam(POT_PARAMS + 8, 0.f, 1.f, 0.5f, "Row 3 Col 1");
-        configParam(POT_PARAMS + 9, 0.f, 1.f, 0.5f, "Row 3 Col 2");
-        configParam(POT_PARAMS + 10, 0.f, 1.f, 0.5f, "Row 3 Col 3");
-        configParam(POT_PARAMS + 11, 0.f, 1.f, 0.5f, "Row 3 Col 4");
-        configParam(POT_PARAMS + 12, 0.f, 1.f, 0.5f, "Row 4 Col 1");
-        configParam(POT_PARAMS + 13, 0.f, 1.f, 0.5f, "Row 4 Col 2");
-        configParam(POT_PARAMS + 14, 0.f, 1.f, 0.5f, "Row 4 Col 3");
-        configParam(POT_PARAMS + 15, 0.f, 1.f, 0.5f, "Row 4 Col 4");
-        configParam(ROW_PARAMS + 0, 0.0, 1.0, 0.0, "Mute row 1");
-        configParam(ROW_PARAMS + 1, 0.0, 1.0, 0.0, "Mute row 2");
-        configParam(ROW_PARAMS + 2, 0.0, 1.0, 0.0, "Mute row 3");
-        configParam(ROW_PARAMS + 3, 0.0, 1.0, 0.0, "Mute row 4");
-        configParam(COL_PARAMS + 0, 0.0, 1.0, 0.0, "Mute col 1");
-        configParam(COL_PARAMS + 1, 0.0, 1.0, 0.0, "Mute col 2");
-        configParam(COL_PARAMS + 2, 0.0, 1.0, 0.0, "Mute col 3");
-        configParam(COL_PARAMS + 3, 0.0, 1.0, 0.0, "Mute col 4");
-        configParam(MUTE_ALGO_PARAM, 0.0, 1.0, 0.0, "Mute algorithm");
+        Drawing* drawing = new Drawing();
+        drawing->grid = this;
+        addChild(drawing);
     }
 
-    void process(const ProcessArgs& args) override {
-        lightTheLeds();
-        setAudio();
-        setLightsState();
+    static Vec knobPosition(int row, int col) {
+        return Vec(27.5f + 16.67f * col, 35.5f + 18.67f * row);
     }
 
-    void lightTheLeds() {
-        for (int i = 0; i < 16; i++) {
-            if (ledMatrix[i]) {
-                lights[SMALL_LEDS + i].setBrightness(0.9f);
-            } else {
-                lights[SMALL_LEDS + i].setBrightness(0.f);
-            }
-        }
-        for (int i = 0; i < 4; i++) {
-            if (rowState[i]) {
-                lights[ROW_LEDS + i].setBrightness(0.9f);
-            } else {
-                lights[ROW_LEDS + i].setBrightness(0.f);
-            }
-            if (colState[i]) {
-                lights[COL_LEDS + i].setBrightness(0.9f);
-            } else {
-                lights[COL_LEDS + i].setBrightness(0.f);
-            }
+    static Vec ledPosition(int light) {
+        if (light < MatrixMixer4::ROW_LEDS) {
+            int i = light - MatrixMixer4::SMALL_LEDS;
+            return knobPosition(i / 4, i % 4).plus(Vec(6.f, -6.f));
         }
-        for (int i = 0; i < 4; i++) {
-            if (muteAlgorithm == i + 1) {
-                lights[ALGO_LEDS + i].setBrightness(0.9f);
-            } else {
-                lights[ALGO_LEDS + i].setBrightness(0.f);
-            }
+        if (light < MatrixMixer4::COL_LEDS) {
+            int i = light - MatrixMixer4::ROW_LEDS;
+            return Vec(15.5f, knobPosition(i, 0).y - 6.f);
         }
-    }
-
-    void setAudio() {
-        for (int outputNumber = 0; outputNumber < 4; outputNumber++) {
-            if (outputs[OUT_OUTPUTS + outputNumber].isConnected()) {
-                float out = 0.f;
-                int numberOfConnections = 0;
-
-                for (int i = 0; i < 4; i++) {
-                    if (inputs[IN_INPUTS + i].isConnected() &&
-                            ledMatrix[4 * outputNumber + i]) {
-                        out += inputs[IN_INPUTS + i]
-                               .getVoltage() *
-                               params[POT_PARAMS + (4 * outputNumber) + i]
-                               .getValue();
-                        numberOfConnections++;
-                    }
-                }
-
-                if (amplitudeAlgorithm == 0) {
-                    if (numberOfConnections == 2) {
-                        out *= 0.5;
-                    } else if (numberOfConnections == 3) {
-                        out *= 0.33333;
-                    } else if (numberOfConnections == 4) {
-                        out *= 0.25;
-                    }
-                } else if (amplitudeAlgorithm == 1) {
-                    out = clamp(out, -5.f, 5.f);
-                }
-
-                outputs[OUT_OUTPUTS + outputNumber].setVoltage(out);
-            }
+        if (light < MatrixMixer4::ALGO_LEDS) {
+            int i = light - MatrixMixer4::COL_LEDS;
+            return Vec(knobPosition(0, i).x, 99.9f);
         }
+        int i = light - MatrixMixer4::ALGO_LEDS;
+        return Vec(87.5f, 105.f + 3.5f * i);
     }
 
-    void setLightsState() {
-        if (algoTrigger.process(params[MUTE_ALGO_PARAM].getValue() +
-                                inputs[ALGO_CV_INPUT].getVoltage())) {
-            muteAlgorithm++;
-            if (muteAlgorithm > 3) {
-                muteAlgorithm = 1;
-            }
-        }
-
-        for (int row = 0; row < 4; row++) {
-            if (rowTrigger[row].process(params[ROW_PARAMS + row].getValue() +
-                                   inputs[ROW_CV_INPUTS + row].getVoltage())) {
-                rowState[row] = !rowState[row];
-                for (int i = 0; i < 4; i++) {
-                    int aLed = 4 * row + i;
-                    if (muteAlgorithm == 1) {
-                        ledMatrix[aLed] = rowState[row];
-                    } else if (muteAlgorithm == 3) {
-                        ledMatrix[aLed] = rowState[row] && colState[i];
-                    } else {
-                        ledMatrix[aLed] = !ledMatrix[aLed];
-                    }
+    void step() override {
+        if (module) {
+            for (int i = 0; i < 16; i++) {
+                float value = module->params[MatrixMixer4::POT_PARAMS + i].getValue();
+                if (value != knobs[i]) {
+                    knobs[i] = value;
+                    dirty = true;
                 }
             }
-        }
-
-        for (int col = 0; col < 4; col++) {
-            if (colTrigger[col].process(params[COL_PARAMS + col].getValue() +
-                                    inputs[COL_CV_INPUTS + col].getVoltage())) {
-                colState[col] = !colState[col];
-                for (int i = 0; i < 4; i++) {
-                    int aLed = col + i * 4;
-                    if (muteAlgorithm == 1) {
-                        ledMatrix[aLed] = colState[col];
-                    } else if (muteAlgorithm == 3) {
-                        ledMatrix[aLed] = colState[col] && rowState[i];
-                    } else {
-                        ledMatrix[aLed] = !ledMatrix[aLed];
-                    }
+            for (int i = 0; i < MatrixMixer4::NUM_LIGHTS; i++) {
+                float value = module->lights[i].getBrightness();
+                if (value != leds[i]) {
+                    leds[i] = value;
+                    dirty = true;
                 }
             }
         }
+        FramebufferWidget::step();
     }
 
-    json_t *dataToJson() override {
-        json_t *rootJ = json_object();
-
-        json_t* ledsJ = json_array();
-        for (int i = 0; i < 16; i++) {
-            json_t* ledJ = json_boolean(ledMatrix[i]);
-            json_array_append_new(ledsJ, ledJ);
+    void drawKnob(NVGcontext* vg, Vec center, float value) {
+        if (!knobSvg || !knobSvg->handle) {
+            return;
         }
-        json_object_set_new(rootJ, "leds", ledsJ);
+        Vec size = Vec(knobSvg->handle->width, knobSvg->handle->height);
+
+        // Like the CircularShadow of SvgKnob: the disc of the knob, a tenth
+        // of its size lower.
+        nvgBeginPath(vg);
+        nvgCircle(vg, center.x, center.y + 0.1f * size.y, size.x / 2.f);
+        nvgFillColor(vg, nvgRGBAf(0.f, 0.f, 0.f, 0.15f));
+        nvgFill(vg);
+
+        float angle = rescale(value, 0.f, 1.f, KNOB_MIN_ANGLE, KNOB_MAX_ANGLE);
+        nvgSave(vg);
+        nvgTranslate(vg, center.x, center.y);
+        nvgRotate(vg, angle);
+        nvgTranslate(vg, -size.x / 2.f, -size.y / 2.f);
+        svgDraw(vg, knobSvg->handle);
+        nvgRestore(vg);
+    }
 
-        json_t* rowsJ = json_array();
-        for (int i = 0; i < 4; i++) {
-            json_t* rowJ = json_boolean(rowState[i]);
-            json_array_append_new(rowsJ, rowJ);
-        }
-        json_object_set_new(rootJ, "rows", rowsJ);
+    void drawLed(NVGcontext* vg, Vec center, float radius, NVGcolor color,
+                 float brightness) {
+        nvgBeginPath(vg);
+        nvgCircle(vg, center.x, center.y, radius);
+        nvgFillColor(vg, nvgRGB(0x5a, 0x5a, 0x5a));
+        nvgFill(vg);
 
-        json_t* colsJ = json_array();
-        for (int i = 0; i < 4; i++) {
-            json_t* colJ = json_boolean(colState[i]);
-            json_array_append_new(colsJ, colJ);
+        if (brightness <= 0.f) {
+            return;
         }
-        json_object_set_new(rootJ, "cols", colsJ);
-
-        json_object_set_new(rootJ, "amplitudeAlgorithm",
-                            json_integer(amplitudeAlgorithm));
-
-        json_object_set_new(rootJ, "muteAlgorithm",
-                            json_integer(muteAlgorithm));
 
-        return rootJ;
+        nvgBeginPath(vg);
+        nvgCircle(vg, center.x, center.y, radius);
+        nvgFillColor(vg, nvgTransRGBAf(color, brightness));
+        nvgFill(vg);
+
+        float haloRadius = radius * 3.f;
+        nvgBeginPath(vg);
+        nvgCircle(vg, center.x, center.y, haloRadius);
+        nvgFillPaint(vg, nvgRadialGradient(vg, center.x, center.y, radius,
+                     haloRadius, nvgTransRGBAf(color, 0.07f * brightness),
+                     nvgTransRGBAf(color, 0.f)));
+        nvgFill(vg);
     }
 
-    void dataFromJson(json_t* rootJ) override {
-        json_t* ledsJ = json_object_get(rootJ, "leds");
-        if (ledsJ) {
-            for (int i = 0; i < 16; i++) {
-                json_t* ledJ = json_array_get(ledsJ, i);
-                if (ledJ) ledMatrix[i] = json_boolean_value(ledJ);
-            }
-        }
-
-        json_t* rowsJ = json_object_get(rootJ, "rows");
-        if (rowsJ) {
-            for (int i = 0; i < 4; i++) {
-                json_t* rowJ = json_array_get(rowsJ, i);
-                if (rowJ) rowState[i] = json_boolean_value(rowJ);
-            }
+    void drawGrid(NVGcontext* vg) {
+        for (int i = 0; i < 16; i++) {
+            drawKnob(vg, mm2px(knobPosition(i / 4, i % 4)), knobs[i]);
         }
 
-        json_t* colsJ = json_object_get(rootJ, "cols");
-        if (colsJ) {
-            for (int i = 0; i < 4; i++) {
-                json_t* colJ = json_array_get(colsJ, i);
-                if (colJ) colState[i] = json_boolean_value(colJ);
+        // Same sizes and colors as SmallLight and TinyLight with
+        // GreenLight, YellowLight and RedLight.
+        float smallRadius = mm2px(Vec(2.176f, 0.f)).x / 2.f;
+        float tinyRadius = mm2px(Vec(1.088f, 0.f)).x / 2.f;
+        for (int i = 0; i < MatrixMixer4::NUM_LIGHTS; i++) {
+            Vec center = mm2px(ledPosition(i));
+            if (i < MatrixMixer4::ROW_LEDS) {
+                drawLed(vg, center, smallRadius, SCHEME_GREEN, leds[i]);
+            } else if (i < MatrixMixer4::ALGO_LEDS) {
+                drawLed(vg, center, smallRadius, SCHEME_YELLOW, leds[i]);
+            } else {
+                drawLed(vg, center, tinyRadius, SCHEME_RED, leds[i]);
             }
         }
-
-        json_t *amplitudeAlgorithmJ = json_object_get(rootJ,
-                                                      "amplitudeAlgorithm");
-        if (amplitudeAlgorithmJ) {
-            amplitudeAlgorithm = json_integer_value(amplitudeAlgorithmJ);
-        }
-
-        json_t *muteAlgorithmJ = json_object_get(rootJ, "muteAlgorithm");
-        if (muteAlgorithmJ) {
-            muteAlgorithm = json_integer_value(muteAlgorithmJ);
-        }
-    }
-};
-
-
-template <typename BASE>
-struct MuteLight : BASE {
-    MuteLight() {
-        this->box.size = mm2px(Vec(6.f, 6.f));
     }
 };
 
 struct MatrixMixer4Widget : ModuleWidget {
     MatrixMixer4Widget(MatrixMixer4* module) {
+        PanelTimer timer("MatrixMixer4");
         setModule(module);
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MatrixMixer4.svg")));
 
@@ -299,22 +241,19 @@ struct MatrixMixer4Widget : ModuleWidget {
         addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
         addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(27.5, 35.5)), module, MatrixMixer4::POT_PARAMS + 0));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(44.17, 35.5)), module, MatrixMixer4::POT_PARAMS + 1));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(60.84, 35.5)), module, MatrixMixer4::POT_PARAMS + 2));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(77.51, 35.5)), module, MatrixMixer4::POT_PARAMS + 3));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(27.5, 54.17)), module, MatrixMixer4::POT_PARAMS + 4));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(44.17, 54.17)), module, MatrixMixer4::POT_PARAMS + 5));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(60.84, 54.17)), module, MatrixMixer4::POT_PARAMS + 6));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(77.51, 54.17)), module, MatrixMixer4::POT_PARAMS + 7));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(27.5, 72.84)), module, MatrixMixer4::POT_PARAMS + 8));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(44.17, 72.84)), module, MatrixMixer4::POT_PARAMS + 9));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(60.84, 72.84)), module, MatrixMixer4::POT_PARAMS + 10));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(77.51, 72.84)), module, MatrixMixer4::POT_PARAMS + 11));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(27.5, 91.51)), module, MatrixMixer4::POT_PARAMS + 12));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(44.17, 91.51)), module, MatrixMixer4::POT_PARAMS + 13));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(60.84, 91.51)), module, MatrixMixer4::POT_PARAMS + 14));
-        addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(77.51, 91.51)), module, MatrixMixer4::POT_PARAMS + 15));
+        // Knob faces and LEDs are all drawn by the grid; the knobs themselves
+        // only handle the mouse.
+        MatrixMixer4Grid* grid = new MatrixMixer4Grid(module);
+        grid->box.size = box.size;
+        addChild(grid);
+
+        for (int row = 0; row < 4; row++) {
+            for (int col = 0; col < 4; col++) {
+                addParam(createParamCentered<MatrixMixer4Knob>(
+                            mm2px(MatrixMixer4Grid::knobPosition(row, col)),
+                            module, MatrixMixer4::POT_PARAMS + 4 * row + col));
+            }
+        }
 
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(27.5, 19.5)), module, MatrixMixer4::IN_INPUTS + 0));
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(44.17, 19.5)), module, MatrixMixer4::IN_INPUTS + 1));
@@ -329,43 +268,15 @@ struct MatrixMixer4Widget : ModuleWidget {
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(60.84, 115.0)), module, MatrixMixer4::COL_CV_INPUTS + 2));
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(77.51, 115.0)), module, MatrixMixer4::COL_CV_INPUTS + 3));
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(93.6, 115.0)), module, MatrixMixer4::ALGO_CV_INPUT));
+        addInput(createInputCentered<PJ301MPort>(mm2px(Vec(6.426, 115.0)), module, MatrixMixer4::POT_CV_INPUT));
+        addInput(createInputCentered<PJ301MPort>(mm2px(Vec(6.426, 19.5)), module, MatrixMixer4::TRIM_CV_INPUT));
+        addInput(createInputCentered<PJ301MPort>(mm2px(Vec(93.6, 19.5)), module, MatrixMixer4::MASTER_CV_INPUT));
 
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(93.6, 35.5)), module, MatrixMixer4::OUT_OUTPUTS + 0));
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(93.6, 54.17)), module, MatrixMixer4::OUT_OUTPUTS + 1));
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(93.6, 72.84)), module, MatrixMixer4::OUT_OUTPUTS + 2));
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(93.6, 91.51)), module, MatrixMixer4::OUT_OUTPUTS + 3));
 
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(33.5, 29.5)), module, MatrixMixer4::SMALL_LEDS + 0));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(50.17, 29.5)), module, MatrixMixer4::SMALL_LEDS + 1));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(66.84, 29.5)), module, MatrixMixer4::SMALL_LEDS + 2));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(83.51, 29.5)), module, MatrixMixer4::SMALL_LEDS + 3));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(33.5, 48.17)), module, MatrixMixer4::SMALL_LEDS + 4));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(50.17, 48.17)), module, MatrixMixer4::SMALL_LEDS + 5));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(66.84, 48.17)), module, MatrixMixer4::SMALL_LEDS + 6));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(83.51, 48.17)), module, MatrixMixer4::SMALL_LEDS + 7));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(33.5, 66.84)), module, MatrixMixer4::SMALL_LEDS + 8));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(50.17, 66.84)), module, MatrixMixer4::SMALL_LEDS + 9));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(66.84, 66.84)), module, MatrixMixer4::SMALL_LEDS + 10));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(83.51, 66.84)), module, MatrixMixer4::SMALL_LEDS + 11));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(33.5, 85.51)), module, MatrixMixer4::SMALL_LEDS + 12));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(50.17, 85.51)), module, MatrixMixer4::SMALL_LEDS + 13));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(66.84, 85.51)), module, MatrixMixer4::SMALL_LEDS + 14));
-        addChild(createLightCentered<SmallLight<GreenLight>>(mm2px(Vec(83.51, 85.51)), module, MatrixMixer4::SMALL_LEDS + 15));
-
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(15.5, 29.5)), module, MatrixMixer4::ROW_LEDS + 0));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(15.5, 48.17)), module, MatrixMixer4::ROW_LEDS + 1));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(15.5, 66.84)), module, MatrixMixer4::ROW_LEDS + 2));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(15.5, 85.51)), module, MatrixMixer4::ROW_LEDS + 3));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(27.5, 99.9)), module, MatrixMixer4::COL_LEDS + 0));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(44.17, 99.9)), module, MatrixMixer4::COL_LEDS + 1));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(60.84, 99.9)), module, MatrixMixer4::COL_LEDS + 2));
-        addChild(createLightCentered<SmallLight<YellowLight>>(mm2px(Vec(77.51, 99.9)), module, MatrixMixer4::COL_LEDS + 3));
-
-        addChild(createLightCentered<TinyLight<RedLight>>(mm2px(Vec(87.5, 105.0)), module, MatrixMixer4::ALGO_LEDS + 0));
-        addChild(createLightCentered<TinyLight<RedLight>>(mm2px(Vec(87.5, 108.5)), module, MatrixMixer4::ALGO_LEDS + 1));
-        addChild(createLightCentered<TinyLight<RedLight>>(mm2px(Vec(87.5, 112.0)), module, MatrixMixer4::ALGO_LEDS + 2));
-        addChild(createLightCentered<TinyLight<RedLight>>(mm2px(Vec(87.5, 115.5)), module, MatrixMixer4::ALGO_LEDS + 3));
-
         addChild(createParamCentered<TL1105>(mm2px(Vec(15.5, 35.5)), module, MatrixMixer4::ROW_PARAMS + 0));
         addChild(createParamCentered<TL1105>(mm2px(Vec(15.5, 54.17)), module, MatrixMixer4::ROW_PARAMS + 1));
         addChild(createParamCentered<TL1105>(mm2px(Vec(15.5, 72.84)), module, MatrixMixer4::ROW_PARAMS + 2));
@@ -375,6 +286,14 @@ struct MatrixMixer4Widget : ModuleWidget {
         addChild(createParamCentered<TL1105>(mm2px(Vec(60.84, 105.9)), module, MatrixMixer4::COL_PARAMS + 2));
         addChild(createParamCentered<TL1105>(mm2px(Vec(77.51, 105.9)), module, MatrixMixer4::COL_PARAMS + 3));
         addChild(createParamCentered<TL1105>(mm2px(Vec(93.6, 105.9)), module, MatrixMixer4::MUTE_ALGO_PARAM));
+
+        // Nothing to meter in the module browser.
+        if (module) {
+            MatrixMixer4MeterDisplay* meterDisplay = new MatrixMixer4MeterDisplay();
+            meterDisplay->box.size = box.size;
+            meterDisplay->module = module;
+            addChild(meterDisplay);
+        }
     }
 
     struct MatrixMixer4AmplitudeItem : MenuItem {
@@ -388,6 +307,55 @@ struct MatrixMixer4Widget : ModuleWidget {
         }
     };
 
+    struct MatrixMixer4PotCvItem : MenuItem {
+        MatrixMixer4 *module;
+        int mode;
+        void onAction(const event::Action &e) override {
+            module->potCvMode = mode;
+        }
+        void step() override {
+            rightText = (module->potCvMode == mode) ? "✔" : "";
+        }
+    };
+
+    struct MatrixMixer4MuteItem : MenuItem {
+        MatrixMixer4 *module;
+        int algo;
+        void onAction(const event::Action &e) override {
+            module->pendingMuteAlgorithm = algo;
+        }
+        void step() override {
+            rightText = (module->muteAlgorithm == algo) ? "✔" : "";
+        }
+    };
+
+    struct MatrixMixer4StereoItem : MenuItem {
+        MatrixMixer4 *module;
+        void onAction(const event::Action &e) override {
+            module->stereo ^= true;
+        }
+        void step() override {
+            rightText = module->stereo ? "✔" : "";
+        }
+    };
+
+    // For the params without knob: one slider per param.
+    struct MatrixMixer4SlidersItem : MenuItem {
+        MatrixMixer4 *module;
+        int firstParam;
+        int count;
+        Menu* createChildMenu() override {
+            Menu* menu = new Menu;
+            for (int i = 0; i < count; i++) {
+                ui::Slider* slider = new ui::Slider;
+                slider->quantity = module->paramQuantities[firstParam + i];
+                slider->box.size.x = 200.f;
+                menu->addChild(slider);
+            }
+            return menu;
+        }
+    };
+
     void appendContextMenu(Menu *menu) override {
         MenuLabel *spacerLabel = new MenuLabel();
         menu->addChild(spacerLabel);
@@ -416,6 +384,82 @@ struct MatrixMixer4Widget : ModuleWidget {
         item3->module = module;
         item3->algo = 2;
         menu->addChild(item3);
+
+        MatrixMixer4AmplitudeItem *item4 = new MatrixMixer4AmplitudeItem();
+        item4->text = "Adaptive ducking";
+        item4->module = module;
+        item4->algo = 3;
+        menu->addChild(item4);
+
+        MenuLabel *muteLabel = new MenuLabel();
+        muteLabel->text = "Mute Algorithm";
+        menu->addChild(muteLabel);
+
+        for (int i = 0; i < NUM_MUTE_ALGORITHMS; i++) {
+            MatrixMixer4MuteItem *item = new MatrixMixer4MuteItem();
+            item->text = MUTE_ALGORITHMS[i].name;
+            item->module = module;
+            item->algo = i + 1;
+            menu->addChild(item);
+        }
+
+        MenuLabel *potCvLabel = new MenuLabel();
+        potCvLabel->text = "Potentiometers CV";
+        menu->addChild(potCvLabel);
+
+        MatrixMixer4PotCvItem *potCvItem1 = new MatrixMixer4PotCvItem();
+        potCvItem1->text = "Add (default)";
+        potCvItem1->module = module;
+        potCvItem1->mode = 0;
+        menu->addChild(potCvItem1);
+
+        MatrixMixer4PotCvItem *potCvItem2 = new MatrixMixer4PotCvItem();
+        potCvItem2->text = "Multiply";
+        potCvItem2->module = module;
+        potCvItem2->mode = 1;
+        menu->addChild(potCvItem2);
+
+        MenuLabel *stereoLabel = new MenuLabel();
+        stereoLabel->text = "Stereo";
+        menu->addChild(stereoLabel);
+
+        MatrixMixer4StereoItem *stereoItem = new MatrixMixer4StereoItem();
+        stereoItem->text = "L/R pairs on channels 1 and 2";
+        stereoItem->module = module;
+        menu->addChild(stereoItem);
+
+        MatrixMixer4SlidersItem *panItem = new MatrixMixer4SlidersItem();
+        panItem->text = "Pan";
+        panItem->rightText = "▸";
+        panItem->module = module;
+        panItem->firstParam = MatrixMixer4::PAN_PARAMS;
+        panItem->count = 16;
+        menu->addChild(panItem);
+
+        MenuLabel *levelsLabel = new MenuLabel();
+        levelsLabel->text = "Levels";
+        menu->addChild(levelsLabel);
+
+        MatrixMixer4SlidersItem *trimItem = new MatrixMixer4SlidersItem();
+        trimItem->text = "Input trims";
+        trimItem->rightText = "▸";
+        trimItem->module = module;
+        trimItem->firstParam = MatrixMixer4::TRIM_PARAMS;
+        trimItem->count = 4;
+        menu->addChild(trimItem);
+
+        MatrixMixer4SlidersItem *masterItem = new MatrixMixer4SlidersItem();
+        masterItem->text = "Output masters";
+        masterItem->rightText = "▸";
+        masterItem->module = module;
+        masterItem->firstParam = MatrixMixer4::MASTER_PARAMS;
+        masterItem->count = 4;
+        menu->addChild(masterItem);
+
+        menu->addChild(new MenuLabel());
+
+        appendStateTraceMenu(menu, &module->trace, describeMatrixMixer4Event,
+                             "Matrix Mixer 4");
     }
 };
 
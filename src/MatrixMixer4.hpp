@@ -0,0 +1,863 @@
+#pragma once
+#include "plugin.hpp"
+#include "MixKernels.hpp"
+#include "StateTrace.hpp"
+#include <atomic>
+
+using simd::float_4;
+
+// Levels of the 4 inputs and 4 outputs, as shown by the panel meters. One
+// cache line.
+struct alignas(CACHE_LINE) MatrixMixer4Meters {
+    float inPeak[4] = {};
+    float inRms[4] = {};
+    float outPeak[4] = {};
+    float outRms[4] = {};
+};
+
+// What a mute button does to the potentiometers of its row or column. The
+// new state of the potentiometers is
+//     ledMask = ((ledMask & keep) ^ flip) | set
+// where keep, flip and set are picked among the masks of MuteMasks.
+struct MuteAlgorithm {
+    enum MuteMasks {
+        NONE,
+        ALL,
+        LINE,               // The row (or column) of the button
+        NOT_LINE,
+        LINE_IF_ON,         // The line, if the button has just unmuted it
+        LINE_INTERSECTIONS, // The line, where both row and column are on
+        INTERSECTIONS,      // Everywhere both row and column are on
+        NUM_MUTE_MASKS
+    };
+
+    const char* name;
+    uint8_t keep;
+    uint8_t flip;
+    uint8_t set;
+    bool exclusiveRows; // When a row is unmuted, the other rows are muted.
+};
+
+static const int NUM_MUTE_ALGORITHMS = 4;
+
+static const MuteAlgorithm MUTE_ALGORITHMS[NUM_MUTE_ALGORITHMS] = {
+    {"Force", MuteAlgorithm::NOT_LINE, MuteAlgorithm::NONE,
+              MuteAlgorithm::LINE_IF_ON, false},
+    {"Flip-flop", MuteAlgorithm::ALL, MuteAlgorithm::LINE,
+                  MuteAlgorithm::NONE, false},
+    {"Intersections", MuteAlgorithm::NOT_LINE, MuteAlgorithm::NONE,
+                      MuteAlgorithm::LINE_INTERSECTIONS, false},
+    {"Exclusive rows", MuteAlgorithm::NONE, MuteAlgorithm::NONE,
+                       MuteAlgorithm::INTERSECTIONS, true},
+};
+
+struct MatrixMixer4 : Module, CacheAligned {
+
+    // The meters are published to the UI every METER_DIVISION samples.
+    static const int METER_DIVISION = 256;
+
+    // With the adaptive ducking, an input counts as a whole voice from this
+    // level (in Volts), and as a fraction of one below it.
+    static constexpr float ACTIVE_LEVEL = 1.f;
+
+    // The pans, trims and masters are looked at every CONTROLS_DIVISION
+    // samples.
+    static const int CONTROLS_DIVISION = 32;
+
+    enum ParamIds {
+        ENUMS(POT_PARAMS, 16),
+        ENUMS(ROW_PARAMS, 4),
+        ENUMS(COL_PARAMS, 4),
+        MUTE_ALGO_PARAM,
+        // No knob for these, they are set from the context menu.
+        ENUMS(PAN_PARAMS, 16),
+        ENUMS(TRIM_PARAMS, 4),
+        ENUMS(MASTER_PARAMS, 4),
+        NUM_PARAMS
+    };
+
+    enum InputIds {
+        ENUMS(IN_INPUTS, 4),
+        ENUMS(ROW_CV_INPUTS, 4),
+        ENUMS(COL_CV_INPUTS, 4),
+        ALGO_CV_INPUT,
+        POT_CV_INPUT,
+        TRIM_CV_INPUT,
+        MASTER_CV_INPUT,
+        NUM_INPUTS
+    };
+
+    enum OutputIds {
+        ENUMS(OUT_OUTPUTS, 4),
+        NUM_OUTPUTS
+    };
+
+    enum LightIds {
+        ENUMS(SMALL_LEDS, 16),
+        ENUMS(ROW_LEDS, 4),
+        ENUMS(COL_LEDS, 4),
+        ENUMS(ALGO_LEDS, 4),
+        NUM_LIGHTS
+    };
+
+    // What changed the state, in the trace. For the rows and columns, the
+    // trace holds the led masks before and after, for the mute algorithm,
+    // the algorithms.
+    enum TraceCauses {
+        ENUMS(ROW_BUTTON_CAUSES, 4),
+        ENUMS(ROW_CV_CAUSES, 4),
+        ENUMS(COL_BUTTON_CAUSES, 4),
+        ENUMS(COL_CV_CAUSES, 4),
+        ALGO_BUTTON_CAUSE,
+        ALGO_CV_CAUSE,
+        ALGO_MENU_CAUSE
+    };
+
+    // The members are grouped by cache line: what the context menu writes,
+    // what only the audio thread writes, and what it publishes to the UI, so
+    // that the audio thread's writes stay off the lines the UI and the
+    // neighbouring modules write.
+
+    // Amplitude algorithm:
+    //   0 - Ducking (the more voices in a row, the less amplitude per voice)
+    //   1 - Hard clipping 10 Vpp
+    //   2 - No processing
+    //   3 - Adaptive ducking (like 0, counting only the voices playing)
+    alignas(CACHE_LINE) int amplitudeAlgorithm = 0;
+
+    // What the polyphonic CV does to the potentiometers:
+    //   0 - Add (10 V is a full turn)
+    //   1 - Multiply (10 V is unity gain)
+    int potCvMode = 0;
+
+    // Stereo mode: each input and output carries a L/R pair, as channels 1
+    // and 2 of its cable.
+    bool stereo = false;
+
+    // The mute algorithm chosen from the context menu, 0 once the audio
+    // thread has switched to it. The switch changes the mute state, so it is
+    // made and traced by the audio thread, like the button does.
+    std::atomic<int> pendingMuteAlgorithm{0};
+
+    // Mute algorithm (do not use 0), see MUTE_ALGORITHMS:
+    //   0 - I repeat, DO NOT USE 0!
+    //   1 - Force (default)
+    //   2 - Flip-flop (it's like XOR)
+    //   3 - Intersections (it's like AND)
+    //   4 - Exclusive rows (each input goes to one output at most)
+    // Only the audio thread writes it, the menu asks through
+    // pendingMuteAlgorithm.
+    alignas(CACHE_LINE) int muteAlgorithm = 1;
+
+    dsp::BooleanTrigger rowTrigger[4];
+    dsp::BooleanTrigger colTrigger[4];
+    dsp::BooleanTrigger algoTrigger;
+
+    // Mute state, one bit per potentiometer (bit 4 * row + col), per row and
+    // per column. A set bit means enabled.
+    uint16_t ledMask;
+    uint8_t rowMask;
+    uint8_t colMask;
+    // The enabled potentiometers of each column (input), as lane masks over
+    // the 4 rows (outputs). Derived from ledMask.
+    float_4 routes[4];
+    // Whether the outputs were last given several channels.
+    bool polyphonic = false;
+
+    // Stereo. The pan gains of each row, for inputs 1-2 then 3-4, in the
+    // order of the samples: L, R, L, R. Computed from the PAN_PARAMS, only
+    // when one of them changes.
+    float_4 panGains[4][2];
+    float pans[16];
+
+    // Input trims and output masters, folded into the gains as a matrix like
+    // them: lane row of column i is master[row] * trim[i]. Computed from the
+    // TRIM_PARAMS and MASTER_PARAMS, only when one of them changes.
+    float_4 stageGains[4];
+    float_4 trims;
+    float_4 masters;
+    dsp::ClockDivider controlsDivider;
+
+    // Adaptive ducking. Envelope of each input, one lane per input.
+    float_4 follower = 0.f;
+    float attackCoefficient = 0.f;
+    float releaseCoefficient = 0.f;
+    float followerSampleTime = 0.f;
+
+    // Metering. Envelopes are computed on the audio thread, one lane per
+    // input or output, then published through a triple buffer (see meters).
+    float_4 inPeak = 0.f;
+    float_4 outPeak = 0.f;
+    float_4 inMeanSquare = 0.f;
+    float_4 outMeanSquare = 0.f;
+    float_4 inPeakHold = 0.f;
+    float_4 outPeakHold = 0.f;
+    float rmsCoefficient = 0.f;
+    float peakDecay = 0.f;
+    float meterSampleTime = 0.f;
+    dsp::ClockDivider meterDivider;
+    int metersBack = 0; // The snapshot the audio thread writes.
+
+    // Triple buffer: the audio thread fills its back snapshot, then swaps it
+    // with the middle one, flagged fresh. The UI swaps its front snapshot with
+    // the middle one when that is fresh, and reads the front. Each side only
+    // touches the snapshot it holds, so the UI never sees one half written,
+    // however long it takes to copy it.
+    static const int METERS_FRESH = 4;
+    alignas(CACHE_LINE) std::atomic<int> metersMiddle{1};
+    int metersFront = 2; // The snapshot the UI reads.
+    MatrixMixer4Meters meters[3];
+
+    // The last state changes, for the context menu.
+    StateTrace trace;
+
+    void onAdd() override {
+    }
+
+    void onReset() override {
+        reset();
+    }
+
+    void reset() {
+        ledMask = 0xffff;
+        rowMask = 0xf;
+        colMask = 0xf;
+        updateRoutes();
+        updatePans(true);
+        updateStages(true);
+    }
+
+    MatrixMixer4() {
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        configParam(POT_PARAMS + 0, 0.f, 1.f, 0.5f, "Row 1 Col 1");
+        configParam(POT_PARAMS + 1, 0.f, 1.f, 0.5f, "Row 1 Col 2");
+        configParam(POT_PARAMS + 2, 0.f, 1.f, 0.5f, "Row 1 Col 3");
+        configParam(POT_PARAMS + 3, 0.f, 1.f, 0.5f, "Row 1 Col 4");
+        configParam(POT_PARAMS + 4, 0.f, 1.f, 0.5f, "Row 2 Col 1");
+        configParam(POT_PARAMS + 5, 0.f, 1.f, 0.5f, "Row 2 Col 2");
+        configParam(POT_PARAMS + 6, 0.f, 1.f, 0.5f, "Row 2 Col 3");
+        configParam(POT_PARAMS + 7, 0.f, 1.f, 0.5f, "Row 2 Col 4");
+        configParam(POT_PARAMS + 8, 0.f, 1.f, 0.5f, "Row 3 Col 1");
+        configParam(POT_PARAMS + 9, 0.f, 1.f, 0.5f, "Row 3 Col 2");
+        configParam(POT_PARAMS + 10, 0.f, 1.f, 0.5f, "Row 3 Col 3");
+        configParam(POT_PARAMS + 11, 0.f, 1.f, 0.5f, "Row 3 Col 4");
+        configParam(POT_PARAMS + 12, 0.f, 1.f, 0.5f, "Row 4 Col 1");
+        configParam(POT_PARAMS + 13, 0.f, 1.f, 0.5f, "Row 4 Col 2");
+        configParam(POT_PARAMS + 14, 0.f, 1.f, 0.5f, "Row 4 Col 3");
+        configParam(POT_PARAMS + 15, 0.f, 1.f, 0.5f, "Row 4 Col 4");
+        configParam(ROW_PARAMS + 0, 0.0, 1.0, 0.0, "Mute row 1");
+        configParam(ROW_PARAMS + 1, 0.0, 1.0, 0.0, "Mute row 2");
+        configParam(ROW_PARAMS + 2, 0.0, 1.0, 0.0, "Mute row 3");
+        configParam(ROW_PARAMS + 3, 0.0, 1.0, 0.0, "Mute row 4");
+        configParam(COL_PARAMS + 0, 0.0, 1.0, 0.0, "Mute col 1");
+        configParam(COL_PARAMS + 1, 0.0, 1.0, 0.0, "Mute col 2");
+        configParam(COL_PARAMS + 2, 0.0, 1.0, 0.0, "Mute col 3");
+        configParam(COL_PARAMS + 3, 0.0, 1.0, 0.0, "Mute col 4");
+        configParam(MUTE_ALGO_PARAM, 0.0, 1.0, 0.0, "Mute algorithm");
+        for (int i = 0; i < 16; i++) {
+            configParam(PAN_PARAMS + i, -1.f, 1.f, 0.f,
+                        "Row " + std::to_string(i / 4 + 1) +
+                        " Col " + std::to_string(i % 4 + 1) + " pan",
+                        "%", 0.f, 100.f);
+        }
+        for (int i = 0; i < 4; i++) {
+            configParam(TRIM_PARAMS + i, 0.f, 2.f, 1.f,
+                        "Input " + std::to_string(i + 1) + " trim",
+                        " dB", -10.f, 20.f);
+            configParam(MASTER_PARAMS + i, 0.f, 2.f, 1.f,
+                        "Output " + std::to_string(i + 1) + " master",
+                        " dB", -10.f, 20.f);
+        }
+
+        meterDivider.setDivision(METER_DIVISION);
+        controlsDivider.setDivision(CONTROLS_DIVISION);
+        reset();
+    }
+
+    void process(const ProcessArgs& args) override {
+        trace.tick(args.sampleTime);
+        if (controlsDivider.process()) {
+            updatePans(false);
+            updateStages(false);
+        }
+        lightTheLeds();
+        setAudio(args.sampleTime);
+        setLightsState();
+    }
+
+    void lightTheLeds() {
+        for (int i = 0; i < 16; i++) {
+            lights[SMALL_LEDS + i].setBrightness(((ledMask >> i) & 1) * 0.9f);
+        }
+        for (int i = 0; i < 4; i++) {
+            lights[ROW_LEDS + i].setBrightness(((rowMask >> i) & 1) * 0.9f);
+            lights[COL_LEDS + i].setBrightness(((colMask >> i) & 1) * 0.9f);
+        }
+        for (int i = 0; i < 4; i++) {
+            if (muteAlgorithm == i + 1) {
+                lights[ALGO_LEDS + i].setBrightness(0.9f);
+            } else {
+                lights[ALGO_LEDS + i].setBrightness(0.f);
+            }
+        }
+    }
+
+    void setAudio(float sampleTime) {
+        // Every vector below holds one lane per input (in) or per output
+        // (out). Column i of the matrix is the gain of input i on each of the
+        // 4 outputs.
+        float_4 in = 0.f;
+        float_4 out = 0.f;
+        float_4 numberOfConnections = 0.f;
+        float_4 gains[4];
+
+        for (int i = 0; i < 4; i++) {
+            gains[i] = float_4(params[POT_PARAMS + i].getValue(),
+                               params[POT_PARAMS + 4 + i].getValue(),
+                               params[POT_PARAMS + 8 + i].getValue(),
+                               params[POT_PARAMS + 12 + i].getValue());
+        }
+
+        if (inputs[POT_CV_INPUT].isConnected()) {
+            modulateGains(gains);
+        }
+        applyStages(gains);
+
+        if (stereo) {
+            mixStereo(gains, sampleTime);
+            return;
+        }
+
+        int channels = 1;
+        for (int i = 0; i < 4; i++) {
+            channels = std::max(channels, inputs[IN_INPUTS + i].getChannels());
+        }
+        if (channels > 1) {
+            mixPolyphonic(gains, channels, sampleTime);
+            return;
+        }
+        if (polyphonic) {
+            polyphonic = false;
+            for (int i = 0; i < 4; i++) {
+                outputs[OUT_OUTPUTS + i].setChannels(1);
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            if (!inputs[IN_INPUTS + i].isConnected()) {
+                continue;
+            }
+            float voltage = inputs[IN_INPUTS + i].getVoltage();
+            in[i] = voltage;
+            out += voltage * (gains[i] & routes[i]);
+            numberOfConnections += routes[i] & 1.f;
+        }
+
+        if (amplitudeAlgorithm == 0) {
+            out *= simd::ifelse(numberOfConnections >= 2.f,
+                                duckingFactor(numberOfConnections), 1.f);
+        } else if (amplitudeAlgorithm == 1) {
+            out = simd::clamp(out, -5.f, 5.f);
+        } else if (amplitudeAlgorithm == 3) {
+            out *= adaptiveDuckingFactor(simd::abs(in), sampleTime);
+        }
+
+        for (int outputNumber = 0; outputNumber < 4; outputNumber++) {
+            if (outputs[OUT_OUTPUTS + outputNumber].isConnected()) {
+                outputs[OUT_OUTPUTS + outputNumber].setVoltage(out[outputNumber]);
+            }
+        }
+
+        meter(in, out, sampleTime);
+    }
+
+    // With a polyphonic input, the outputs get as many channels as the widest
+    // input, channel c of an output mixing channel c of the inputs (so a
+    // monophonic input only goes to channel 1). The MixKernels of the CPU do
+    // the work, on all 16 channels at once.
+    void mixPolyphonic(float_4* gains, int channels, float sampleTime) {
+        const float* ins[4];
+        int numIns = 0;
+        float_4 in = 0.f;
+        float_4 numberOfConnections = 0.f;
+
+        // Keep the columns of the connected inputs only, packed at the front.
+        for (int i = 0; i < 4; i++) {
+            if (!inputs[IN_INPUTS + i].isConnected()) {
+                continue;
+            }
+            in[i] = inputs[IN_INPUTS + i].getVoltage();
+            ins[numIns] = inputs[IN_INPUTS + i].getVoltages();
+            gains[numIns] = gains[i] & routes[i];
+            numberOfConnections += routes[i] & 1.f;
+            numIns++;
+        }
+
+        float_4 ducking = 1.f;
+        if (amplitudeAlgorithm == 0) {
+            ducking = simd::ifelse(numberOfConnections >= 2.f,
+                                   duckingFactor(numberOfConnections), 1.f);
+        } else if (amplitudeAlgorithm == 3) {
+            ducking = adaptiveDuckingFactor(polyphonicLevels(), sampleTime);
+        }
+        for (int i = 0; i < numIns; i++) {
+            gains[i] *= ducking;
+        }
+
+        // Columns to rows: lane i of gains[row] is the gain of the i-th
+        // connected input on that output.
+        _MM_TRANSPOSE4_PS(gains[0].v, gains[1].v, gains[2].v, gains[3].v);
+
+        float_4 out = 0.f;
+        float unconnected[MIX_KERNELS_CHANNELS];
+        for (int row = 0; row < 4; row++) {
+            Output& output = outputs[OUT_OUTPUTS + row];
+            float* voltages = output.isConnected() ? output.getVoltages() : unconnected;
+            mixKernels->mix(voltages, ins, &gains[row][0], numIns);
+            if (amplitudeAlgorithm == 1) {
+                mixKernels->clip(voltages, 5.f);
+            }
+            output.setChannels(channels);
+            out[row] = voltages[0];
+        }
+        polyphonic = true;
+
+        meter(in, out, sampleTime);
+    }
+
+    // In stereo, the L and R samples of two inputs share a vector, and the
+    // pan gains of each row are in the same order, so that one multiply-add
+    // per row mixes both channels of all the inputs. A monophonic input is
+    // sent to both sides before the pan.
+    void mixStereo(float_4* gains, float sampleTime) {
+        float_4 in = 0.f;
+        float_4 numberOfConnections = 0.f;
+        float_4 pairs[2] = {0.f, 0.f};
+        for (int i = 0; i < 4; i++) {
+            Input& input = inputs[IN_INPUTS + i];
+            if (!input.isConnected()) {
+                continue;
+            }
+            float left = input.getVoltage(0);
+            float right = input.getPolyVoltage(1);
+            pairs[i / 2][2 * (i % 2)] = left;
+            pairs[i / 2][2 * (i % 2) + 1] = right;
+            in[i] = (std::abs(left) > std::abs(right)) ? left : right;
+            gains[i] &= routes[i];
+            numberOfConnections += routes[i] & 1.f;
+        }
+
+        float_4 ducking = 1.f;
+        if (amplitudeAlgorithm == 0) {
+            ducking = simd::ifelse(numberOfConnections >= 2.f,
+                                   duckingFactor(numberOfConnections), 1.f);
+        } else if (amplitudeAlgorithm == 3) {
+            ducking = adaptiveDuckingFactor(simd::abs(in), sampleTime);
+        }
+        for (int i = 0; i < 4; i++) {
+            gains[i] *= ducking;
+        }
+
+        _MM_TRANSPOSE4_PS(gains[0].v, gains[1].v, gains[2].v, gains[3].v);
+
+        float_4 out = 0.f;
+        for (int row = 0; row < 4; row++) {
+            // Each gain twice, for L and R.
+            float_4 low = _mm_unpacklo_ps(gains[row].v, gains[row].v);
+            float_4 high = _mm_unpackhi_ps(gains[row].v, gains[row].v);
+            float_4 mix = pairs[0] * low * panGains[row][0] +
+                          pairs[1] * high * panGains[row][1];
+            // L, R in the first two lanes.
+            mix += _mm_movehl_ps(mix.v, mix.v);
+            if (amplitudeAlgorithm == 1) {
+                mix = simd::clamp(mix, -5.f, 5.f);
+            }
+
+            Output& output = outputs[OUT_OUTPUTS + row];
+            output.setChannels(2);
+            output.setVoltage(mix[0], 0);
+            output.setVoltage(mix[1], 1);
+            out[row] = (std::abs(mix[0]) > std::abs(mix[1])) ? mix[0] : mix[1];
+        }
+        polyphonic = true;
+
+        meter(in, out, sampleTime);
+    }
+
+    // Equal-power pan law, scaled for unity gain at the centre: a centred
+    // crosspoint leaves both channels alone, a hard panned one sends its
+    // side 3 dB louder.
+    void updatePans(bool force) {
+        for (int i = 0; i < 16; i++) {
+            float pan = params[PAN_PARAMS + i].getValue();
+            if (pan == pans[i] && !force) {
+                continue;
+            }
+            pans[i] = pan;
+            float angle = (pan + 1.f) * float(M_PI / 4.0);
+            int row = i / 4;
+            int col = i % 4;
+            panGains[row][col / 2][2 * (col % 2)] = float(M_SQRT2) * std::cos(angle);
+            panGains[row][col / 2][2 * (col % 2) + 1] = float(M_SQRT2) * std::sin(angle);
+        }
+    }
+
+    // With their CV, the trims and masters move at audio rate: the matrix is
+    // made again for each sample.
+    void applyStages(float_4* gains) {
+        bool trimCv = inputs[TRIM_CV_INPUT].isConnected();
+        bool masterCv = inputs[MASTER_CV_INPUT].isConnected();
+        if (!trimCv && !masterCv) {
+            for (int i = 0; i < 4; i++) {
+                gains[i] *= stageGains[i];
+            }
+            return;
+        }
+
+        float_4 trimGains = trims;
+        float_4 masterGains = masters;
+        if (trimCv) {
+            trimGains *= stageCv(inputs[TRIM_CV_INPUT]);
+        }
+        if (masterCv) {
+            masterGains *= stageCv(inputs[MASTER_CV_INPUT]);
+        }
+        for (int i = 0; i < 4; i++) {
+            gains[i] *= masterGains * trimGains[i];
+        }
+    }
+
+    // Channels 1 to 4 of the CV go to the inputs (or outputs) 1 to 4, a
+    // monophonic CV to all of them. 10 V is unity gain, a missing channel
+    // leaves its gain alone.
+    float_4 stageCv(Input& cv) {
+        float channels = cv.isMonophonic() ? 4.f : cv.getChannels();
+        float_4 voltages = simd::ifelse(float_4(0.f, 1.f, 2.f, 3.f) < channels,
+                                        cv.getPolyVoltageSimd<float_4>(0), 10.f);
+        return simd::clamp(voltages * 0.1f, 0.f, 1.f);
+    }
+
+    void updateStages(bool force) {
+        float_4 newTrims = float_4(params[TRIM_PARAMS + 0].getValue(),
+                                   params[TRIM_PARAMS + 1].getValue(),
+                                   params[TRIM_PARAMS + 2].getValue(),
+                                   params[TRIM_PARAMS + 3].getValue());
+        float_4 newMasters = float_4(params[MASTER_PARAMS + 0].getValue(),
+                                     params[MASTER_PARAMS + 1].getValue(),
+                                     params[MASTER_PARAMS + 2].getValue(),
+                                     params[MASTER_PARAMS + 3].getValue());
+        if (!force && !simd::movemask((newTrims != trims) | (newMasters != masters))) {
+            return;
+        }
+        trims = newTrims;
+        masters = newMasters;
+        for (int i = 0; i < 4; i++) {
+            stageGains[i] = masters * trims[i];
+        }
+    }
+
+    // Channel 4 * row + col of the CV input goes to the potentiometer of that
+    // row and column. A monophonic CV goes to all of them, missing channels
+    // leave their potentiometer alone.
+    void modulateGains(float_4* gains) {
+        Input& cv = inputs[POT_CV_INPUT];
+        float channels = cv.isMonophonic() ? 16.f : cv.getChannels();
+        float neutral = (potCvMode == 0) ? 0.f : 10.f;
+        float_4 rows[4];
+        for (int row = 0; row < 4; row++) {
+            float_4 channel = float_4(0.f, 1.f, 2.f, 3.f) + 4.f * row;
+            rows[row] = simd::ifelse(channel < channels,
+                                     cv.getPolyVoltageSimd<float_4>(4 * row),
+                                     neutral);
+        }
+        // Rows to columns, like the gains.
+        _MM_TRANSPOSE4_PS(rows[0].v, rows[1].v, rows[2].v, rows[3].v);
+
+        for (int i = 0; i < 4; i++) {
+            if (potCvMode == 0) {
+                gains[i] = simd::clamp(gains[i] + rows[i] * 0.1f, 0.f, 1.f);
+            } else {
+                gains[i] *= simd::clamp(rows[i] * 0.1f, 0.f, 1.f);
+            }
+        }
+    }
+
+    // The peak of each input over its channels, one lane per input.
+    float_4 polyphonicLevels() {
+        float_4 levels = 0.f;
+        for (int i = 0; i < 4; i++) {
+            Input& input = inputs[IN_INPUTS + i];
+            float_4 peak = 0.f;
+            for (int c = 0; c < input.getChannels(); c += 4) {
+                peak = simd::fmax(peak, simd::abs(input.getVoltageSimd<float_4>(c)));
+            }
+            levels[i] = std::max(std::max(peak[0], peak[1]), std::max(peak[2], peak[3]));
+        }
+        return levels;
+    }
+
+    // Like the ducking, 1 / n for n voices on an output, but each input
+    // counts for its envelope over ACTIVE_LEVEL (at most 1): silent inputs
+    // don't duck the others, and the gain follows the envelopes smoothly.
+    // Envelopes rise in about 5 ms and fall in about 250 ms.
+    float_4 adaptiveDuckingFactor(float_4 levels, float sampleTime) {
+        if (sampleTime != followerSampleTime) {
+            followerSampleTime = sampleTime;
+            attackCoefficient = 1.f - std::exp(-sampleTime / 0.005f);
+            releaseCoefficient = 1.f - std::exp(-sampleTime / 0.25f);
+        }
+
+        follower += (levels - follower) * simd::ifelse(levels > follower,
+                                                       attackCoefficient,
+                                                       releaseCoefficient);
+        float_4 activity = simd::fmin(follower * (1.f / ACTIVE_LEVEL), 1.f);
+
+        float_4 voices = 0.f;
+        for (int i = 0; i < 4; i++) {
+            voices += routes[i] & activity[i];
+        }
+        return 1.f / simd::fmax(voices, 1.f);
+    }
+
+    // Same factors as ever: 1/2, 0.33333 and 1/4 for 2, 3 and 4 voices.
+    static float_4 duckingFactor(float_4 numberOfConnections) {
+        return simd::ifelse(numberOfConnections >= 4.f, 0.25f,
+               simd::ifelse(numberOfConnections >= 3.f, 0.33333f, 0.5f));
+    }
+
+    void meter(float_4 in, float_4 out, float sampleTime) {
+        if (sampleTime != meterSampleTime) {
+            meterSampleTime = sampleTime;
+            // 300 ms RMS window, peak falls by 20 dB in about 1.5 second.
+            rmsCoefficient = 1.f - std::exp(-sampleTime / 0.3f);
+            peakDecay = std::pow(0.1f, sampleTime * METER_DIVISION / 1.5f);
+        }
+
+        inPeakHold = simd::fmax(inPeakHold, simd::abs(in));
+        outPeakHold = simd::fmax(outPeakHold, simd::abs(out));
+        inMeanSquare += (in * in - inMeanSquare) * rmsCoefficient;
+        outMeanSquare += (out * out - outMeanSquare) * rmsCoefficient;
+
+        if (meterDivider.process()) {
+            inPeak = simd::fmax(inPeak * peakDecay, inPeakHold);
+            outPeak = simd::fmax(outPeak * peakDecay, outPeakHold);
+            inPeakHold = 0.f;
+            outPeakHold = 0.f;
+
+            MatrixMixer4Meters& snapshot = meters[metersBack];
+            inPeak.store(snapshot.inPeak);
+            outPeak.store(snapshot.outPeak);
+            simd::sqrt(inMeanSquare).store(snapshot.inRms);
+            simd::sqrt(outMeanSquare).store(snapshot.outRms);
+            metersBack = metersMiddle.exchange(metersBack | METERS_FRESH,
+                                               std::memory_order_acq_rel) & 3;
+        }
+    }
+
+    // Called from the UI thread.
+    MatrixMixer4Meters getMeters() {
+        if (metersMiddle.load(std::memory_order_relaxed) & METERS_FRESH) {
+            metersFront = metersMiddle.exchange(metersFront,
+                                                std::memory_order_acq_rel) & 3;
+        }
+        return meters[metersFront];
+    }
+
+    // A trigger comes from the button if it is pressed, else from the CV.
+    void setLightsState() {
+        if (pendingMuteAlgorithm.load(std::memory_order_relaxed)) {
+            int from = muteAlgorithm;
+            setMuteAlgorithm(pendingMuteAlgorithm.exchange(0));
+            trace.record(from, muteAlgorithm, ALGO_MENU_CAUSE);
+        }
+
+        if (algoTrigger.process(params[MUTE_ALGO_PARAM].getValue() +
+                                inputs[ALGO_CV_INPUT].getVoltage())) {
+            int from = muteAlgorithm;
+            int to = muteAlgorithm + 1;
+            if (to > NUM_MUTE_ALGORITHMS) {
+                to = 1;
+            }
+            setMuteAlgorithm(to);
+            trace.record(from, muteAlgorithm,
+                         (params[MUTE_ALGO_PARAM].getValue() > 0.f) ?
+                         ALGO_BUTTON_CAUSE : ALGO_CV_CAUSE);
+        }
+
+        for (int row = 0; row < 4; row++) {
+            if (rowTrigger[row].process(params[ROW_PARAMS + row].getValue() +
+                                   inputs[ROW_CV_INPUTS + row].getVoltage())) {
+                uint16_t from = ledMask;
+                toggleRow(row);
+                trace.record(from, ledMask,
+                             ((params[ROW_PARAMS + row].getValue() > 0.f) ?
+                              ROW_BUTTON_CAUSES : ROW_CV_CAUSES) + row);
+            }
+        }
+
+        for (int col = 0; col < 4; col++) {
+            if (colTrigger[col].process(params[COL_PARAMS + col].getValue() +
+                                    inputs[COL_CV_INPUTS + col].getVoltage())) {
+                uint16_t from = ledMask;
+                toggleCol(col);
+                trace.record(from, ledMask,
+                             ((params[COL_PARAMS + col].getValue() > 0.f) ?
+                              COL_BUTTON_CAUSES : COL_CV_CAUSES) + col);
+            }
+        }
+    }
+
+    const MuteAlgorithm& currentMuteAlgorithm() {
+        return MUTE_ALGORITHMS[clamp(muteAlgorithm, 1, NUM_MUTE_ALGORITHMS) - 1];
+    }
+
+    // Exclusive rows can't start with several rows unmuted: only the lowest
+    // one stays, with the pots where it meets the unmuted columns.
+    void setMuteAlgorithm(int algorithm) {
+        muteAlgorithm = algorithm;
+        if (currentMuteAlgorithm().exclusiveRows) {
+            rowMask &= (uint8_t) -rowMask;
+            applyMuteAlgorithm(currentMuteAlgorithm(), 0, false);
+        }
+    }
+
+    void toggleRow(int row) {
+        const MuteAlgorithm& algorithm = currentMuteAlgorithm();
+        uint8_t bit = 1 << row;
+        rowMask ^= bit;
+        bool on = rowMask & bit;
+        rowMask &= (algorithm.exclusiveRows && on) ? bit : 0xf;
+        applyMuteAlgorithm(algorithm, 0xf << (4 * row), on);
+    }
+
+    void toggleCol(int col) {
+        uint8_t bit = 1 << col;
+        colMask ^= bit;
+        applyMuteAlgorithm(currentMuteAlgorithm(), 0x1111 << col, colMask & bit);
+    }
+
+    // Spreads the 4 bits of a row mask over the 4 nibbles of a led mask.
+    static uint16_t rowsToLeds(uint16_t rows) {
+        rows = (rows | (rows << 6)) & 0x0303;
+        rows = (rows | (rows << 3)) & 0x1111;
+        return rows * 0xf;
+    }
+
+    void applyMuteAlgorithm(const MuteAlgorithm& algorithm, uint16_t line,
+                            bool on) {
+        uint16_t intersections = rowsToLeds(rowMask) & (colMask * 0x1111);
+        uint16_t masks[MuteAlgorithm::NUM_MUTE_MASKS] = {
+            0,
+            0xffff,
+            line,
+            (uint16_t) ~line,
+            (uint16_t) (line & -on),
+            (uint16_t) (line & intersections),
+            intersections
+        };
+        ledMask = ((ledMask & masks[algorithm.keep]) ^ masks[algorithm.flip])
+                  | masks[algorithm.set];
+        updateRoutes();
+    }
+
+    void updateRoutes() {
+        for (int i = 0; i < 4; i++) {
+            routes[i] = float_4((ledMask >> i) & 1, (ledMask >> (4 + i)) & 1,
+                                (ledMask >> (8 + i)) & 1,
+                                (ledMask >> (12 + i)) & 1) > 0.f;
+        }
+    }
+
+    json_t *dataToJson() override {
+        json_t *rootJ = json_object();
+
+        json_t* ledsJ = json_array();
+        for (int i = 0; i < 16; i++) {
+            json_t* ledJ = json_boolean((ledMask >> i) & 1);
+            json_array_append_new(ledsJ, ledJ);
+        }
+        json_object_set_new(rootJ, "leds", ledsJ);
+
+        json_t* rowsJ = json_array();
+        for (int i = 0; i < 4; i++) {
+            json_t* rowJ = json_boolean((rowMask >> i) & 1);
+            json_array_append_new(rowsJ, rowJ);
+        }
+        json_object_set_new(rootJ, "rows", rowsJ);
+
+        json_t* colsJ = json_array();
+        for (int i = 0; i < 4; i++) {
+            json_t* colJ = json_boolean((colMask >> i) & 1);
+            json_array_append_new(colsJ, colJ);
+        }
+        json_object_set_new(rootJ, "cols", colsJ);
+
+        json_object_set_new(rootJ, "amplitudeAlgorithm",
+                            json_integer(amplitudeAlgorithm));
+
+        json_object_set_new(rootJ, "muteAlgorithm",
+                            json_integer(muteAlgorithm));
+
+        json_object_set_new(rootJ, "potCvMode", json_integer(potCvMode));
+
+        json_object_set_new(rootJ, "stereo", json_boolean(stereo));
+
+        return rootJ;
+    }
+
+    void dataFromJson(json_t* rootJ) override {
+        json_t* ledsJ = json_object_get(rootJ, "leds");
+        if (ledsJ) {
+            for (int i = 0; i < 16; i++) {
+                json_t* ledJ = json_array_get(ledsJ, i);
+                if (ledJ) setBit(ledMask, i, json_boolean_value(ledJ));
+            }
+        }
+
+        json_t* rowsJ = json_object_get(rootJ, "rows");
+        if (rowsJ) {
+            for (int i = 0; i < 4; i++) {
+                json_t* rowJ = json_array_get(rowsJ, i);
+                if (rowJ) setBit(rowMask, i, json_boolean_value(rowJ));
+            }
+        }
+
+        json_t* colsJ = json_object_get(rootJ, "cols");
+        if (colsJ) {
+            for (int i = 0; i < 4; i++) {
+                json_t* colJ = json_array_get(colsJ, i);
+                if (colJ) setBit(colMask, i, json_boolean_value(colJ));
+            }
+        }
+
+        json_t *amplitudeAlgorithmJ = json_object_get(rootJ,
+                                                      "amplitudeAlgorithm");
+        if (amplitudeAlgorithmJ) {
+            amplitudeAlgorithm = json_integer_value(amplitudeAlgorithmJ);
+        }
+
+        json_t *muteAlgorithmJ = json_object_get(rootJ, "muteAlgorithm");
+        if (muteAlgorithmJ) {
+            setMuteAlgorithm(json_integer_value(muteAlgorithmJ));
+        }
+
+        json_t *potCvModeJ = json_object_get(rootJ, "potCvMode");
+        if (potCvModeJ) {
+            potCvMode = json_integer_value(potCvModeJ);
+        }
+
+        json_t *stereoJ = json_object_get(rootJ, "stereo");
+        if (stereoJ) {
+            stereo = json_boolean_value(stereoJ);
+        }
+
+        updateRoutes();
+        updatePans(true);
+        updateStages(true);
+    }
+
+    template <typename T>
+    static void setBit(T& mask, int bit, bool value) {
+        mask = (mask & ~(1 << bit)) | (value << bit);
+    }
+};
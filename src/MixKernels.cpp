@@ -0,0 +1,20 @@
+#include "MixKernels.hpp"
+
+
+const MixKernels* const ALL_MIX_KERNELS[3] = {
+    &mixKernelsAvx512,
+    &mixKernelsAvx2,
+    &mixKernelsSse,
+};
+
+const MixKernels* mixKernels = &mixKernelsSse;
+
+void selectMixKernels() {
+    __builtin_cpu_init();
+    for (const MixKernels* kernels : ALL_MIX_KERNELS) {
+        if (kernels->supported()) {
+            mixKernels = kernels;
+            return;
+        }
+    }
+}
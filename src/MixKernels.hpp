@@ -0,0 +1,32 @@
+#pragma once
+// The hot loops of the Matrix Mixer 4 on polyphonic cables, on whole buffers
+// of 16 channels. They are compiled once per instruction set, from
+// MixKernelsImpl.hpp (see the Makefile for the flags of each variant), and
+// selectMixKernels() picks the widest one the CPU runs, from init().
+
+
+struct MixKernels {
+    const char* name;
+    bool (*supported)();
+
+    // out[c] = sum over i of ins[i][c] * gains[i], for the 16 channels.
+    void (*mix)(float* out, const float* const* ins, const float* gains,
+                int numIns);
+
+    // x[c] = clamp(x[c], -limit, limit), for the 16 channels.
+    void (*clip)(float* x, float limit);
+};
+
+static const int MIX_KERNELS_CHANNELS = 16;
+
+extern const MixKernels mixKernelsSse;
+extern const MixKernels mixKernelsAvx2;
+extern const MixKernels mixKernelsAvx512;
+
+// All the variants, widest first.
+extern const MixKernels* const ALL_MIX_KERNELS[3];
+
+// The variant in use, mixKernelsSse until selectMixKernels() is called.
+extern const MixKernels* mixKernels;
+
+void selectMixKernels();
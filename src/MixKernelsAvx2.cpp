@@ -0,0 +1,7 @@
+// AVX2 and FMA variant of the MixKernels, see AVX2_FLAGS in the Makefile.
+#define MIX_KERNELS mixKernelsAvx2
+#define MIX_KERNELS_NAME "AVX2"
+#define MIX_KERNELS_WIDTH 8
+#define MIX_KERNELS_SUPPORTED() \
+    (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+#include "MixKernelsImpl.hpp"
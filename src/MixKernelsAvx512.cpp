@@ -0,0 +1,7 @@
+// AVX-512 variant of the MixKernels, see AVX512_FLAGS in the Makefile. A
+// whole polyphonic cable fits in one register.
+#define MIX_KERNELS mixKernelsAvx512
+#define MIX_KERNELS_NAME "AVX-512"
+#define MIX_KERNELS_WIDTH 16
+#define MIX_KERNELS_SUPPORTED() __builtin_cpu_supports("avx512f")
+#include "MixKernelsImpl.hpp"
@@ -0,0 +1,47 @@
+// Body of the kernels declared in MixKernels.hpp, included by each variant
+// source after defining MIX_KERNELS (the name of the MixKernels table),
+// MIX_KERNELS_NAME, MIX_KERNELS_WIDTH (floats per register) and
+// MIX_KERNELS_SUPPORTED().
+//
+// Generic vectors, that the compiler emits with the instruction set of the
+// file including this one. Everything here must stay
+// static and must not call inline functions of other headers (std::min,
+// simd::...). The linker keeps a single copy of such functions, possibly
+// one compiled for AVX-512, and older CPUs would then crash in the baseline
+// variant.
+#include "MixKernels.hpp"
+
+
+static bool supported() {
+    return MIX_KERNELS_SUPPORTED();
+}
+
+// MIX_KERNELS_WIDTH channels, one register of the target instruction set.
+typedef float Lanes __attribute__((vector_size(4 * MIX_KERNELS_WIDTH),
+                                   aligned(4), may_alias));
+
+static const int NUM_LANES = MIX_KERNELS_CHANNELS / MIX_KERNELS_WIDTH;
+
+static void mix(float* out, const float* const* ins, const float* gains,
+                int numIns) {
+    Lanes sum[NUM_LANES] = {};
+    for (int i = 0; i < numIns; i++) {
+        const Lanes* in = (const Lanes*) ins[i];
+        for (int k = 0; k < NUM_LANES; k++) {
+            sum[k] += in[k] * gains[i];
+        }
+    }
+    for (int k = 0; k < NUM_LANES; k++) {
+        ((Lanes*) out)[k] = sum[k];
+    }
+}
+
+static void clip(float* x, float limit) {
+    for (int k = 0; k < NUM_LANES; k++) {
+        Lanes v = ((Lanes*) x)[k];
+        v = v < limit ? v : limit;
+        ((Lanes*) x)[k] = v > -limit ? v : -limit;
+    }
+}
+
+extern const MixKernels MIX_KERNELS = {MIX_KERNELS_NAME, supported, mix, clip};
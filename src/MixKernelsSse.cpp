@@ -0,0 +1,7 @@
+// Baseline variant of the MixKernels, with the flags of the plugin (SSE up
+// to SSE3, as -march=nocona).
+#define MIX_KERNELS mixKernelsSse
+#define MIX_KERNELS_NAME "SSE"
+#define MIX_KERNELS_WIDTH 4
+#define MIX_KERNELS_SUPPORTED() true
+#include "MixKernelsImpl.hpp"
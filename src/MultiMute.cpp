@@ -0,0 +1,92 @@
+#include "MultiMute.hpp"
+#include "StateTraceMenu.hpp"
+
+static std::string describeMultiMuteEvent(const StateTraceEvent& event) {
+    static const char* const states[] = {
+        "playing", "muted", "fading in", "fading out"
+    };
+    static const char* const causes[] = {
+        "button", "trigger input", "end of the fade"
+    };
+    return string::f("lane %d: %s -> %s (%s)", event.cause % MultiMute::LANES + 1,
+                     stateTraceName(states, event.from),
+                     stateTraceName(states, event.to),
+                     stateTraceName(causes, event.cause / MultiMute::LANES));
+}
+
+struct MultiMuteWidget : ModuleWidget {
+    MultiMuteWidget(MultiMute* module) {
+        PanelTimer timer("MultiMute");
+        setModule(module);
+        setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/MultiMute.svg")));
+
+        addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
+        addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
+        addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH,
+                        RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+        addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH,
+                        RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+        for (int lane = 0; lane < MultiMute::LANES; lane++) {
+            float y = 27.0 + 12.4 * lane;
+
+            addInput(createInputCentered<PJ301MPort>(mm2px(Vec(6.5, y)),
+                        module, MultiMute::IN_INPUTS + lane));
+            addInput(createInputCentered<PJ301MPort>(mm2px(Vec(16.0, y)),
+                        module, MultiMute::TRIGGER_INPUTS + lane));
+
+            addParam(createParamCentered<LEDBezel>(mm2px(Vec(25.5, y)),
+                        module, MultiMute::MUTE_PARAMS + lane));
+            addChild(createLightCentered<MuteLight<GreenLight>>(mm2px(Vec(25.5, y)),
+                        module, MultiMute::MUTE_LIGHTS + lane));
+
+            addParam(createParamCentered<Trimpot>(mm2px(Vec(35.5, y)),
+                        module, MultiMute::FADE_IN_PARAMS + lane));
+            addParam(createParamCentered<Trimpot>(mm2px(Vec(44.5, y)),
+                        module, MultiMute::FADE_OUT_PARAMS + lane));
+
+            addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(54.46, y)),
+                        module, MultiMute::OUT_OUTPUTS + lane));
+        }
+    }
+
+    struct MultiMuteCurveItem : MenuItem {
+        MultiMute *module;
+        int lane;
+        void onAction(const event::Action &e) override {
+            module->exponentialFades[lane] ^= true;
+        }
+        void step() override {
+            rightText = module->exponentialFades[lane] ? "✔" : "";
+        }
+    };
+
+    void appendContextMenu(Menu *menu) override {
+        MenuLabel *spacerLabel = new MenuLabel();
+        menu->addChild(spacerLabel);
+
+        MultiMute *module = dynamic_cast<MultiMute*>(this->module);
+        assert(module);
+
+        MenuLabel *curveLabel = new MenuLabel();
+        curveLabel->text = "Exponential fades (else linear)";
+        menu->addChild(curveLabel);
+
+        for (int lane = 0; lane < MultiMute::LANES; lane++) {
+            MultiMuteCurveItem *item = new MultiMuteCurveItem();
+            item->text = string::f("Lane %d", lane + 1);
+            item->module = module;
+            item->lane = lane;
+            menu->addChild(item);
+        }
+
+        menu->addChild(new MenuLabel());
+
+        appendStateTraceMenu(menu, &module->trace, describeMultiMuteEvent,
+                             "Multi Mute");
+    }
+
+};
+
+
+Model* modelMultiMute = createModel<MultiMute, MultiMuteWidget>("MultiMute");
@@ -0,0 +1,268 @@
+#pragma once
+#include "plugin.hpp"
+#include "StateTrace.hpp"
+#include "Tables.hpp"
+
+using simd::float_4;
+
+// Eight independent mutes, each with the fades of a Double Mute. The lanes
+// aren't run one after the other: their state is kept as structure of arrays,
+// lane 4 * g + i being lane i of the float_4 of group g, and all the lanes of
+// a group are triggered and faded at once with masks.
+struct MultiMute : Module, CacheAligned {
+
+    static const int LANES = 8;
+    static const int GROUPS = LANES / 4;
+
+    // The fade times, curves and lights are updated every CONTROLS_DIVISION
+    // samples.
+    static const int CONTROLS_DIVISION = 32;
+
+    // The fade time knobs go from 10 ms to 10 s, exponentially.
+    static constexpr float MIN_FADE = 0.01f;
+    static constexpr float FADE_RANGE = 1000.f;
+
+    enum ParamIds {
+        ENUMS(MUTE_PARAMS, LANES),
+        ENUMS(FADE_IN_PARAMS, LANES),
+        ENUMS(FADE_OUT_PARAMS, LANES),
+        NUM_PARAMS
+    };
+    enum InputIds {
+        ENUMS(IN_INPUTS, LANES),
+        ENUMS(TRIGGER_INPUTS, LANES),
+        NUM_INPUTS
+    };
+    enum OutputIds {
+        ENUMS(OUT_OUTPUTS, LANES),
+        NUM_OUTPUTS
+    };
+    enum LightIds {
+        ENUMS(MUTE_LIGHTS, LANES),
+        NUM_LIGHTS
+    };
+
+    // The state of a lane, as Double Mute's.
+    enum States {
+        HIGH,
+        LOW,
+        RAMP_UP,
+        RAMP_DOWN
+    };
+
+    // What changed the state of a lane, in the trace.
+    enum TraceCauses {
+        ENUMS(BUTTON_CAUSES, LANES),
+        ENUMS(TRIGGER_CAUSES, LANES),
+        ENUMS(FADE_END_CAUSES, LANES)
+    };
+
+    // Audio thread state, on its own cache lines. The masks have all bits of
+    // a lane set for true.
+    alignas(CACHE_LINE) float_4 playing[GROUPS];   // Mask, unmuted or fading in.
+    float_4 positions[GROUPS]; // Of the fades: 0 is muted, 1 is playing.
+    float_4 gains[GROUPS];     // The positions, through the curves.
+    float_4 buttons[GROUPS];   // Mask, the buttons were down.
+    float_4 triggers[GROUPS];  // Mask, Schmitt trigger state of the inputs.
+    float_4 fadeInSteps[GROUPS];  // Position change per sample.
+    float_4 fadeOutSteps[GROUPS];
+    float_4 exponentialMasks[GROUPS];
+    float controlsSampleTime = 0.f;
+    const CurveTable* fadeTable; // Shared, see Tables.hpp.
+    dsp::ClockDivider controlsDivider;
+
+    // Set from the context menu.
+    alignas(CACHE_LINE) bool exponentialFades[LANES];
+
+    // The last state changes, for the context menu.
+    StateTrace trace;
+
+    MultiMute() {
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        for (int lane = 0; lane < LANES; lane++) {
+            std::string name = "Lane " + std::to_string(lane + 1);
+            configParam(MUTE_PARAMS + lane, 0.f, 1.f, 0.f, name + " mute");
+            configParam(FADE_IN_PARAMS + lane, 0.f, 1.f, 1.f / 3.f,
+                        name + " fade-in time", " s", FADE_RANGE, MIN_FADE);
+            configParam(FADE_OUT_PARAMS + lane, 0.f, 1.f, 1.f / 3.f,
+                        name + " fade-out time", " s", FADE_RANGE, MIN_FADE);
+        }
+
+        controlsDivider.setDivision(CONTROLS_DIVISION);
+        fadeTable = &exponentialFadeTable();
+
+        for (int g = 0; g < GROUPS; g++) {
+            buttons[g] = float_4::zero();
+            triggers[g] = float_4::zero();
+        }
+        onReset();
+    }
+
+    void onReset() override {
+        for (int lane = 0; lane < LANES; lane++) {
+            exponentialFades[lane] = true;
+        }
+        for (int g = 0; g < GROUPS; g++) {
+            playing[g] = float_4::mask();
+            positions[g] = 1.f;
+            gains[g] = 1.f;
+        }
+    }
+
+    void process(const ProcessArgs& args) override {
+        trace.tick(args.sampleTime);
+        if (controlsDivider.process() || args.sampleTime != controlsSampleTime) {
+            updateControls(args.sampleTime);
+        }
+
+        for (int g = 0; g < GROUPS; g++) {
+            advance(g);
+        }
+
+        for (int lane = 0; lane < LANES; lane++) {
+            applyGain(lane, gains[lane / 4][lane % 4]);
+        }
+    }
+
+    // Toggles the lanes of a group whose button was pushed or whose trigger
+    // input went high, and moves their fades one sample on.
+    void advance(int g) {
+        int first = 4 * g;
+        float_4 pressed = float_4(params[MUTE_PARAMS + first].getValue(),
+                                  params[MUTE_PARAMS + first + 1].getValue(),
+                                  params[MUTE_PARAMS + first + 2].getValue(),
+                                  params[MUTE_PARAMS + first + 3].getValue()) > 0.f;
+        float_4 cv = float_4(inputs[TRIGGER_INPUTS + first].getVoltage(),
+                             inputs[TRIGGER_INPUTS + first + 1].getVoltage(),
+                             inputs[TRIGGER_INPUTS + first + 2].getVoltage(),
+                             inputs[TRIGGER_INPUTS + first + 3].getVoltage());
+        // High from 1 V, low again from 0 V.
+        float_4 high = simd::ifelse(triggers[g], cv > 0.f, cv >= 1.f);
+
+        float_4 pushed = pressed & ~buttons[g];
+        float_4 toggled = pushed | (high & ~triggers[g]);
+        buttons[g] = pressed;
+        triggers[g] = high;
+
+        // Most of the time, nothing moves.
+        int toggledLanes = simd::movemask(toggled);
+        float_4 wasSettled = settled(g);
+        if (!toggledLanes && simd::movemask(wasSettled) == 0xf) {
+            return;
+        }
+
+        float_4 wasPlaying = playing[g];
+        playing[g] ^= toggled;
+        float_4 step = simd::ifelse(playing[g], fadeInSteps[g], -fadeOutSteps[g]);
+        positions[g] = simd::clamp(positions[g] + step, 0.f, 1.f);
+        gains[g] = simd::ifelse(exponentialMasks[g], (*fadeTable)(positions[g]),
+                                positions[g]);
+
+        int endedLanes = simd::movemask(settled(g) & ~(wasSettled & ~toggled));
+        if (toggledLanes | endedLanes) {
+            recordChanges(g, toggledLanes, simd::movemask(pushed), endedLanes,
+                          simd::movemask(wasPlaying), wasSettled);
+        }
+    }
+
+    // Mask of the lanes at the end of their fade.
+    float_4 settled(int g) {
+        return positions[g] == simd::ifelse(playing[g], 1.f, 0.f);
+    }
+
+    static States laneState(bool playing, bool settled) {
+        if (playing) {
+            return settled ? HIGH : RAMP_UP;
+        }
+        return settled ? LOW : RAMP_DOWN;
+    }
+
+    // Rare: a lane was toggled, or its fade is over.
+    void recordChanges(int g, int toggledLanes, int pushedLanes, int endedLanes,
+                       int wasPlayingLanes, float_4 wasSettled) {
+        int playingLanes = simd::movemask(playing[g]);
+        int wasSettledLanes = simd::movemask(wasSettled);
+        for (int i = 0; i < 4; i++) {
+            int lane = 4 * g + i;
+            bool isPlaying = (playingLanes >> i) & 1;
+            if ((toggledLanes >> i) & 1) {
+                States from = laneState((wasPlayingLanes >> i) & 1,
+                                        (wasSettledLanes >> i) & 1);
+                int cause = ((pushedLanes >> i) & 1) ? BUTTON_CAUSES : TRIGGER_CAUSES;
+                trace.record(from, laneState(isPlaying, false), cause + lane);
+            }
+            if ((endedLanes >> i) & 1) {
+                trace.record(isPlaying ? RAMP_UP : RAMP_DOWN,
+                             isPlaying ? HIGH : LOW, FADE_END_CAUSES + lane);
+            }
+        }
+    }
+
+    // Polyphonic cables are faded channel by channel.
+    void applyGain(int lane, float gain) {
+        Input& in = inputs[IN_INPUTS + lane];
+        Output& out = outputs[OUT_OUTPUTS + lane];
+        int channels = in.getChannels();
+        out.setChannels(channels);
+        for (int c = 0; c < channels; c += 4) {
+            out.setVoltageSimd(in.getVoltageSimd<float_4>(c) * gain, c);
+        }
+    }
+
+    static float fadeTime(float value) {
+        return MIN_FADE * std::pow(FADE_RANGE, value);
+    }
+
+    void updateControls(float sampleTime) {
+        controlsSampleTime = sampleTime;
+        for (int lane = 0; lane < LANES; lane++) {
+            int g = lane / 4;
+            int i = lane % 4;
+            fadeInSteps[g][i] = sampleTime / fadeTime(params[FADE_IN_PARAMS + lane].getValue());
+            fadeOutSteps[g][i] = sampleTime / fadeTime(params[FADE_OUT_PARAMS + lane].getValue());
+            exponentialMasks[g][i] = exponentialFades[lane] ? 1.f : 0.f;
+            lights[MUTE_LIGHTS + lane].setBrightness(0.9f * gains[g][i]);
+        }
+        for (int g = 0; g < GROUPS; g++) {
+            exponentialMasks[g] = exponentialMasks[g] > 0.f;
+        }
+    }
+
+    json_t *dataToJson() override {
+        json_t *rootJ = json_object();
+        json_t *playingJ = json_array();
+        json_t *exponentialFadesJ = json_array();
+        for (int lane = 0; lane < LANES; lane++) {
+            json_array_append_new(playingJ, json_boolean(
+                    simd::movemask(playing[lane / 4]) & (1 << (lane % 4))));
+            json_array_append_new(exponentialFadesJ,
+                                  json_boolean(exponentialFades[lane]));
+        }
+        json_object_set_new(rootJ, "playing", playingJ);
+        json_object_set_new(rootJ, "exponentialFades", exponentialFadesJ);
+        return rootJ;
+    }
+
+    // The lanes start at the end of their fade.
+    void dataFromJson(json_t *rootJ) override {
+        json_t *playingJ = json_object_get(rootJ, "playing");
+        if (playingJ) {
+            for (int g = 0; g < GROUPS; g++) {
+                for (int i = 0; i < 4; i++) {
+                    positions[g][i] = json_boolean_value(
+                            json_array_get(playingJ, 4 * g + i)) ? 1.f : 0.f;
+                }
+                playing[g] = positions[g] > 0.f;
+                gains[g] = positions[g];
+            }
+        }
+
+        json_t *exponentialFadesJ = json_object_get(rootJ, "exponentialFades");
+        for (int lane = 0; lane < LANES; lane++) {
+            json_t *exponentialJ = json_array_get(exponentialFadesJ, lane);
+            if (exponentialJ) {
+                exponentialFades[lane] = json_boolean_value(exponentialJ);
+            }
+        }
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+// Flight recorder of the state changes of a module: the last changes,
+// with the sample frame they happened on, the old and new state and what
+// caused them. The meaning of the states and causes is up to each module.
+//
+// The audio thread writes, without locking nor allocating. The UI thread
+// reads copies, retrying nothing: events overwritten while being copied are
+// just dropped.
+#include "plugin.hpp"
+#include <atomic>
+#include <vector>
+
+
+struct StateTraceEvent {
+    uint64_t frame; // Sample frames processed before this one.
+    double time;    // The same, in seconds.
+    uint16_t from;
+    uint16_t to;
+    uint8_t cause;
+};
+
+struct alignas(CACHE_LINE) StateTrace {
+    static const int SIZE = 64;
+
+    // Call once per process(), before any record().
+    void tick(float sampleTime) {
+        frame++;
+        time += this->sampleTime;
+        this->sampleTime = sampleTime;
+    }
+
+    // Audio thread only.
+    void record(int from, int to, int cause) {
+        uint64_t index = written.load(std::memory_order_relaxed);
+        StateTraceEvent& event = events[index % SIZE];
+        event.frame = frame;
+        event.time = time;
+        event.from = from;
+        event.to = to;
+        event.cause = cause;
+        written.store(index + 1, std::memory_order_release);
+    }
+
+    // The last SIZE - 1 events, oldest first. UI thread. The slot after the
+    // last event may be being written, the one before the oldest.
+    std::vector<StateTraceEvent> read() const {
+        uint64_t end = written.load(std::memory_order_acquire);
+        uint64_t begin = (end >= SIZE) ? end - SIZE + 1 : 0;
+        std::vector<StateTraceEvent> copy;
+        copy.reserve(end - begin);
+        for (uint64_t i = begin; i < end; i++) {
+            copy.push_back(events[i % SIZE]);
+        }
+
+        // Drop the events the audio thread may have overwritten meanwhile.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now = written.load(std::memory_order_relaxed);
+        uint64_t valid = (now >= SIZE) ? now - SIZE + 1 : 0;
+        if (valid > begin) {
+            copy.erase(copy.begin(),
+                       copy.begin() + std::min<uint64_t>(valid - begin, copy.size()));
+        }
+        return copy;
+    }
+
+    // Audio thread only. Count from -1 so that the first frame is 0.
+    uint64_t frame = -1;
+    double time = 0.0;
+    float sampleTime = 0.f;
+    std::atomic<uint64_t> written{0};
+    StateTraceEvent events[SIZE];
+};
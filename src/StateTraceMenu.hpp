@@ -0,0 +1,94 @@
+#pragma once
+// Context menu of a StateTrace: the recorded state changes, most recent
+// first, and an item to save them to a text file.
+#include "StateTrace.hpp"
+#include <osdialog.h>
+
+
+// What an event means, in words, e.g. "playing -> fading out (button)".
+typedef std::string (*StateTraceDescriber)(const StateTraceEvent& event);
+
+// names[index], or "?" for an index the table does not cover: a describer
+// must not trust what it reads from a trace.
+template <size_t N>
+const char* stateTraceName(const char* const (&names)[N], unsigned index) {
+    return index < N ? names[index] : "?";
+}
+
+inline std::string formatStateTraceEvent(const StateTraceEvent& event,
+                                         StateTraceDescriber describe) {
+    return string::f("%.4f s, frame %llu: %s", event.time,
+                     (unsigned long long) event.frame, describe(event).c_str());
+}
+
+struct StateTraceExportItem : MenuItem {
+    const StateTrace* trace;
+    StateTraceDescriber describe;
+    std::string moduleName;
+
+    void onAction(const event::Action& e) override {
+        // Copy first: the dialog takes its time, the trace goes on.
+        std::vector<StateTraceEvent> events = trace->read();
+
+        osdialog_filters* filters = osdialog_filters_parse("Text:txt");
+        char* path = osdialog_file(OSDIALOG_SAVE, NULL,
+                                   (moduleName + " trace.txt").c_str(), filters);
+        osdialog_filters_free(filters);
+        if (!path) {
+            return;
+        }
+
+        FILE* file = std::fopen(path, "w");
+        if (file) {
+            std::fprintf(file, "%s state changes, oldest first\n", moduleName.c_str());
+            for (const StateTraceEvent& event : events) {
+                std::fprintf(file, "%s\n", formatStateTraceEvent(event, describe).c_str());
+            }
+            std::fclose(file);
+        } else {
+            WARN("Could not write the state trace to %s", path);
+        }
+        std::free(path);
+    }
+};
+
+struct StateTraceItem : MenuItem {
+    const StateTrace* trace;
+    StateTraceDescriber describe;
+    std::string moduleName;
+
+    Menu* createChildMenu() override {
+        Menu* menu = new Menu;
+        std::vector<StateTraceEvent> events = trace->read();
+        if (events.empty()) {
+            MenuLabel* label = new MenuLabel();
+            label->text = "No state change yet";
+            menu->addChild(label);
+        }
+        for (auto it = events.rbegin(); it != events.rend(); ++it) {
+            MenuLabel* label = new MenuLabel();
+            label->text = formatStateTraceEvent(*it, describe);
+            menu->addChild(label);
+        }
+
+        StateTraceExportItem* exportItem = new StateTraceExportItem();
+        exportItem->text = "Export…";
+        exportItem->trace = trace;
+        exportItem->describe = describe;
+        exportItem->moduleName = moduleName;
+        menu->addChild(exportItem);
+        return menu;
+    }
+};
+
+inline void appendStateTraceMenu(Menu* menu, const StateTrace* trace,
+                                 StateTraceDescriber describe,
+                                 const std::string& moduleName) {
+    StateTraceItem* item = new StateTraceItem();
+    item->text = "State trace";
+    item->rightText = "▸";
+    item->trace = trace;
+    item->describe = describe;
+    item->moduleName = moduleName;
+    menu->addChild(item);
+}
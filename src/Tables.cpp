@@ -0,0 +1,11 @@
+#include "Tables.hpp"
+
+
+// Function-local statics are built once, thread-safely, on the first call.
+
+const CurveTable& exponentialFadeTable() {
+    static const CurveTable table([](float x) {
+        return rescale(std::pow(50.f, x), 1.f, 50.f, 0.f, 1.f);
+    });
+    return table;
+}
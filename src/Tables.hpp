@@ -0,0 +1,47 @@
+#pragma once
+// Lookup tables shared by all the instances of all the modules. Each one is
+// built on first use, by whichever thread gets there first (usually the one
+// creating the first module that needs it), and is read-only after that.
+// Modules keep a pointer to the tables they use, taken in their constructor.
+#include "plugin.hpp"
+
+
+// A curve on [0, 1], sampled at SIZE + 1 points, read with linear
+// interpolation.
+struct alignas(CACHE_LINE) CurveTable {
+    static const int SIZE = 256;
+
+    float values[SIZE + 1];
+
+    template <typename F>
+    explicit CurveTable(F curve) {
+        for (int i = 0; i <= SIZE; i++) {
+            values[i] = curve((float) i / SIZE);
+        }
+    }
+
+    // x must be in [0, 1].
+    float operator()(float x) const {
+        float position = x * SIZE;
+        int i = std::min((int) position, SIZE - 1);
+        float t = position - i;
+        return values[i] + t * (values[i + 1] - values[i]);
+    }
+
+    // Lane by lane, for the lookups only.
+    simd::float_4 operator()(simd::float_4 x) const {
+        simd::float_4 position = x * SIZE;
+        simd::float_4 start, below, above;
+        for (int lane = 0; lane < 4; lane++) {
+            int i = std::min((int) position[lane], SIZE - 1);
+            start[lane] = i;
+            below[lane] = values[i];
+            above[lane] = values[i + 1];
+        }
+        return below + (position - start) * (above - below);
+    }
+};
+
+// The exponential fade of Double Mute and 2 x 2 Mute, pow(50, x) rescaled to
+// [0, 1]. Off by 3e-5 at most.
+const CurveTable& exponentialFadeTable();
@@ -1,276 +1,21 @@
-#include "plugin.hpp"
+#include "TwoByTwo.hpp"
+#include "StateTraceMenu.hpp"
 
-struct TwoByTwo : Module {
-
-    const float PRESET_FADE = 0.1;
-
-    enum ParamIds {
-        MUTE_PARAM,
-        FADE_PARAM,
-        SCALE_PARAM,
-        NUM_PARAMS
+static std::string describeTwoByTwoEvent(const StateTraceEvent& event) {
+    static const char* const states[] = {
+        "group 1", "group 2", "fading to group 1", "fading to group 2"
     };
-
-    enum InputIds {
-        ENUMS(IN_INPUTS, 4),
-        TRIGGER_MUTE_INPUT,
-        NUM_INPUTS
-    };
-
-    enum OutputIds {
-        ENUMS(OUT_OUTPUTS, 4),
-        NUM_OUTPUTS
-    };
-
-    enum LightIds {
-        MUTE_LIGHT,
-        RAMP_LIGHT,
-        GROUP1_LIGHT,
-        GROUP2_LIGHT,
-        NUM_LIGHTS
-    };
-
-    enum States {
-        HIGH,
-        LOW,
-        RAMP_UP,
-        RAMP_DOWN
+    static const char* const causes[] = {
+        "button", "trigger input", "end of the fade"
     };
-
-    States state;
-    dsp::BooleanTrigger muteTrigger;
-    float fadeInTime;
-    float fadeOutTime;
-    bool exponentialFade = false; // If not it's linear.
-
-    TwoByTwo() {
-        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
-        configParam(MUTE_PARAM, 0.0, 1.0, 0.0, "Mute channels");
-        configParam(FADE_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-in/out time");
-        configParam(SCALE_PARAM, 0.0, 2.0, 0.0, "Fade-in/out scale");
-
-        onReset();
-    }
-
-    void onReset() override {
-        lights[RAMP_LIGHT].setBrightness(0.f);
-        lights[GROUP1_LIGHT].setBrightness(0.f);
-        lights[GROUP2_LIGHT].setBrightness(0.f);
-    }
-
-    // We need an initial state. For that matter, HIGH is as good as LOW.
-    void onAdd() override {
-        if (state != HIGH && state != LOW) {
-            state = HIGH;
-        }
-    }
-
-    void process(const ProcessArgs& args) override {
-        setState();
-
-        switch(state) {
-            case HIGH:
-                high();
-                break;
-            case RAMP_UP:
-                // Fade in group 1.
-                rampUp(args.sampleTime, 0, 1);
-                // Fade out group 2.
-                rampDown(args.sampleTime, 2, 3);
-                break;
-            case RAMP_DOWN:
-                // Fade out group 1.
-                rampDown(args.sampleTime, 0, 1);
-                // Fade in group 2.
-                rampUp(args.sampleTime, 2, 3);
-                break;
-            case LOW:
-                low();
-                break;
-            default:
-                printf("*** NO STATE :(((\n");
-                break;
-        }
-    }
-
-    void setLights(float muteL, float rampL, float group1L, float group2L) {
-        lights[MUTE_LIGHT].setBrightness(muteL);
-        lights[RAMP_LIGHT].setBrightness(rampL);
-        lights[GROUP1_LIGHT].setBrightness(group1L);
-        lights[GROUP2_LIGHT].setBrightness(group2L);
-    }
-
-    void setState() {
-        if (muteTrigger.process(params[MUTE_PARAM].getValue() > 0.f)
-                || inputs[TRIGGER_MUTE_INPUT].getNormalVoltage(0.f) > 0.f) {
-            switch(state) {
-                case HIGH:
-                    state = RAMP_DOWN;
-                    fadeOutTime = rampTime();
-                    fadeInTime = 0.f;
-                    setLights(0.f, 0.9f, 0.f, 0.9f);
-                    break;
-                case RAMP_UP:
-                    state = RAMP_DOWN;
-                    exchangeFades();
-                    setLights(0.f, 0.9f, 0.f, 0.9f);
-                    break;
-                case RAMP_DOWN:
-                    state = RAMP_UP;
-                    exchangeFades();
-                    setLights(0.9f, 0.9f, 0.9f, 0.f);
-                    break;
-                case LOW:
-                    state = RAMP_UP;
-                    fadeOutTime = rampTime();
-                    fadeInTime = 0.f;
-                    setLights(0.9f, 0.9f, 0.9f, 0.f);
-                    break;
-                default:
-                    printf("*** NO STATE WHEN TRIGGERED!\n");
-                    break;
-            }
-        }
-    }
-
-    // This is useful when we trigger a RAMP_UP from a RAMP_DOWN state
-    // and vice versa. We exchange fade-in and fade-out to (kind of)
-    // move backward.
-    void exchangeFades() {
-        float temp = fadeInTime;
-        fadeInTime = fadeOutTime;
-        fadeOutTime = temp;
-    }
-
-    // The time of the fade-in/out, as set by the user.
-    float rampTime() {
-        float time = params[FADE_PARAM].getValue();
-        int mult = (int) std::round(params[SCALE_PARAM].getValue());
-        switch(mult) {
-            case 1:
-                time *= 10;
-                break;
-            case 2:
-                time *= 100;
-                break;
-            default:
-                break;
-        }
-        return time;
-    }
-
-    // Play group 1, full amplitude.
-    void high() {
-        playFullInput(0);
-        playFullInput(1);
-    }
-
-    // Play group 2, full amplitude.
-    void low() {
-        playFullInput(2);
-        playFullInput(3);
-    }
-
-    inline void playFullInput(int inputNumber) {
-        if (inputs[IN_INPUTS + inputNumber].isConnected() &&
-               outputs[OUT_OUTPUTS + inputNumber].isConnected()) {
-            outputs[OUT_OUTPUTS + inputNumber].setVoltage(
-                    inputs[IN_INPUTS + inputNumber].getVoltage());
-        }
-    }
-
-    inline void playPartInput(int inputNumber, float mult) {
-        if (inputs[IN_INPUTS + inputNumber].isConnected() &&
-               outputs[OUT_OUTPUTS + inputNumber].isConnected()) {
-            outputs[OUT_OUTPUTS + inputNumber].setVoltage(
-                    inputs[IN_INPUTS + inputNumber].getVoltage() * mult);
-        }
-    }
-
-    // Fade-in the 2 inputs of a given group.
-    void rampUp(float sampleTime, int channelA, int channelB) {
-        fadeInTime += sampleTime;
-        float userValue = rampTime();
-        float mult = fadeInTime / userValue;
-        mult = clamp(mult, 0.f, 1.f);
-
-        if (exponentialFade) {
-            mult = rescale(std::pow(50.f, mult), 1.f, 50.f, 0.f, 1.f);
-        }
-
-        playPartInput(channelA, mult);
-        playPartInput(channelB, mult);
-
-        if (fadeInTime >= userValue) {
-            if (state == RAMP_UP) {
-                state = HIGH;
-                lights[RAMP_LIGHT].setBrightness(0.f);
-            }
-        }
-    }
-
-    // Fade-out the 2 inputs of a given group.
-    void rampDown(float sampleTime, int channelA, int channelB) {
-        fadeOutTime -= sampleTime;
-        float userValue = rampTime();
-        float mult = fadeOutTime / userValue;
-        mult = clamp(mult, 0.f, 1.f);
-
-        if (exponentialFade) {
-            mult = rescale(std::pow(50.f, mult), 1.f, 50.f, 0.f, 1.f);
-        }
-
-        playPartInput(channelA, mult);
-        playPartInput(channelB, mult);
-
-        if (fadeOutTime <= 0.f) {
-            if (state == RAMP_DOWN) {
-                state = LOW;
-                lights[RAMP_LIGHT].setBrightness(0.f);
-            }
-        } else {
-            lights[RAMP_LIGHT].setBrightness(mult);
-        }
-    }
-
-    json_t *dataToJson() override {
-        float value;
-        value = (state == HIGH || state == RAMP_UP) ? 1 : 0;
-        json_t *rootJ = json_object();
-        json_object_set_new(rootJ, "state", json_integer(value));
-        json_object_set_new(rootJ, "exponentialFade", json_integer((int) exponentialFade));
-        return rootJ;
-    }
-
-    void dataFromJson(json_t *rootJ) override {
-        json_t *stateJ = json_object_get(rootJ, "state");
-        if (stateJ) {
-            float value = json_integer_value(stateJ);
-            if (value == 1) {
-                state = HIGH;
-                setLights(0.9f, 0.f, 0.9f, 0.f);
-            } else {
-                state = LOW;
-                setLights(0.f, 0.f, 0.f, 0.9f);
-            }
-        }
-
-        json_t *exponentialFadeJ = json_object_get(rootJ, "exponentialFade");
-        if (exponentialFadeJ) {
-            exponentialFade = json_integer_value(exponentialFadeJ);
-        }
-    }
-};
-
-template <typename BASE>
-struct MuteLight : BASE {
-    MuteLight() {
-        this->box.size = mm2px(Vec(6.f, 6.f));
-    }
-};
+    return string::f("%s -> %s (%s)", stateTraceName(states, event.from),
+                     stateTraceName(states, event.to),
+                     stateTraceName(causes, event.cause));
+}
 
 struct TwoByTwoWidget : ModuleWidget {
     TwoByTwoWidget(TwoByTwo* module) {
+        PanelTimer timer("TwoByTwo");
         setModule(module);
         setPanel(APP->window->loadSvg(asset::plugin(pluginInstance, "res/2x2Mute.svg")));
 
@@ -298,6 +43,10 @@ struct TwoByTwoWidget : ModuleWidget {
                     module, TwoByTwo::IN_INPUTS + 3));
         addInput(createInputCentered<PJ301MPort>(mm2px(Vec(15.24, 52.0)),
                     module, TwoByTwo::TRIGGER_MUTE_INPUT));
+        addInput(createInputCentered<PJ301MPort>(mm2px(Vec(25.28, 99.5)),
+                    module, TwoByTwo::XFADE_CV_INPUT));
+        addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(5.2, 99.5)),
+                    module, TwoByTwo::ENV_OUTPUT));
 
         addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(22.86, 22.0)),
                     module, TwoByTwo::OUT_OUTPUTS + 0));
@@ -351,6 +100,11 @@ struct TwoByTwoWidget : ModuleWidget {
         item2->module = module;
         item2->mode = false;
         menu->addChild(item2);
+
+        menu->addChild(new MenuLabel());
+
+        appendStateTraceMenu(menu, &module->trace, describeTwoByTwoEvent,
+                             "2 x 2 Mute");
     }
 
 };
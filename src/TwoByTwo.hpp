@@ -0,0 +1,355 @@
+#pragma once
+#include "plugin.hpp"
+#include "StateTrace.hpp"
+#include "Tables.hpp"
+
+using simd::float_4;
+
+struct TwoByTwo : Module, CacheAligned {
+
+    const float PRESET_FADE = 0.1;
+
+    enum ParamIds {
+        MUTE_PARAM,
+        FADE_PARAM,
+        SCALE_PARAM,
+        NUM_PARAMS
+    };
+
+    enum InputIds {
+        ENUMS(IN_INPUTS, 4),
+        TRIGGER_MUTE_INPUT,
+        XFADE_CV_INPUT,
+        NUM_INPUTS
+    };
+
+    enum OutputIds {
+        ENUMS(OUT_OUTPUTS, 4),
+        ENV_OUTPUT,
+        NUM_OUTPUTS
+    };
+
+    enum LightIds {
+        MUTE_LIGHT,
+        RAMP_LIGHT,
+        GROUP1_LIGHT,
+        GROUP2_LIGHT,
+        NUM_LIGHTS
+    };
+
+    enum States {
+        HIGH,
+        LOW,
+        RAMP_UP,
+        RAMP_DOWN
+    };
+
+    // What changed the state, in the trace.
+    enum TraceCauses {
+        BUTTON_CAUSE,
+        TRIGGER_CAUSE,
+        FADE_END_CAUSE
+    };
+
+    // Audio thread state, on its own cache line.
+    alignas(CACHE_LINE) States state;
+    dsp::BooleanTrigger muteTrigger;
+    float fadeInTime;
+    float fadeOutTime;
+    float envelopes[2] = {}; // Gain of each group.
+    bool crossfading = false;
+    const CurveTable* fadeTable; // Shared, see Tables.hpp.
+
+    // Set from the context menu.
+    alignas(CACHE_LINE) bool exponentialFade = false; // If not it's linear.
+
+    // The last state changes, for the context menu.
+    StateTrace trace;
+
+    TwoByTwo() {
+        config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
+        configParam(MUTE_PARAM, 0.0, 1.0, 0.0, "Mute channels");
+        configParam(FADE_PARAM, 0.01, 1.0, PRESET_FADE, "Fade-in/out time");
+        configParam(SCALE_PARAM, 0.0, 2.0, 0.0, "Fade-in/out scale");
+
+        fadeTable = &exponentialFadeTable();
+
+        onReset();
+    }
+
+    void onReset() override {
+        lights[RAMP_LIGHT].setBrightness(0.f);
+        lights[GROUP1_LIGHT].setBrightness(0.f);
+        lights[GROUP2_LIGHT].setBrightness(0.f);
+    }
+
+    // We need an initial state. For that matter, HIGH is as good as LOW.
+    void onAdd() override {
+        if (state != HIGH && state != LOW) {
+            state = HIGH;
+        }
+    }
+
+    void process(const ProcessArgs& args) override {
+        trace.tick(args.sampleTime);
+
+        if (inputs[XFADE_CV_INPUT].isConnected()) {
+            crossfadeByCv(inputs[XFADE_CV_INPUT].getVoltage());
+            sendEnvelopes();
+            return;
+        }
+        if (crossfading) {
+            crossfading = false;
+            restoreLights();
+        }
+
+        setState();
+
+        switch(state) {
+            case HIGH:
+                high();
+                break;
+            case RAMP_UP:
+                // Fade in group 1.
+                rampUp(args.sampleTime, 0);
+                // Fade out group 2.
+                rampDown(args.sampleTime, 1);
+                break;
+            case RAMP_DOWN:
+                // Fade out group 1.
+                rampDown(args.sampleTime, 0);
+                // Fade in group 2.
+                rampUp(args.sampleTime, 1);
+                break;
+            case LOW:
+                low();
+                break;
+            default:
+                printf("*** NO STATE :(((\n");
+                break;
+        }
+        play(float_4(envelopes[0], envelopes[0], envelopes[1], envelopes[1]));
+        sendEnvelopes();
+    }
+
+    // Plays each connected input/output pair with its gain.
+    void play(float_4 gains) {
+        for (int i = 0; i < 4; i++) {
+            if (inputs[IN_INPUTS + i].isConnected() &&
+                    outputs[OUT_OUTPUTS + i].isConnected()) {
+                outputs[OUT_OUTPUTS + i].setVoltage(
+                        inputs[IN_INPUTS + i].getVoltage() * gains[i]);
+            }
+        }
+    }
+
+    // The gains of group 1 and group 2 on the 2 channels of the envelope
+    // output, 10 V being unity.
+    void sendEnvelopes() {
+        outputs[ENV_OUTPUT].setChannels(2);
+        outputs[ENV_OUTPUT].setVoltage(10.f * envelopes[0], 0);
+        outputs[ENV_OUTPUT].setVoltage(10.f * envelopes[1], 1);
+    }
+
+    void setLights(float muteL, float rampL, float group1L, float group2L) {
+        lights[MUTE_LIGHT].setBrightness(muteL);
+        lights[RAMP_LIGHT].setBrightness(rampL);
+        lights[GROUP1_LIGHT].setBrightness(group1L);
+        lights[GROUP2_LIGHT].setBrightness(group2L);
+    }
+
+    // The lights of the current state, when leaving the crossfade CV mode.
+    void restoreLights() {
+        switch(state) {
+            case HIGH:
+                setLights(0.9f, 0.f, 0.9f, 0.f);
+                break;
+            case RAMP_UP:
+                setLights(0.9f, 0.9f, 0.9f, 0.f);
+                break;
+            case RAMP_DOWN:
+                setLights(0.f, 0.9f, 0.f, 0.9f);
+                break;
+            default:
+                setLights(0.f, 0.f, 0.f, 0.9f);
+                break;
+        }
+    }
+
+    void setState() {
+        TraceCauses cause;
+        if (muteTrigger.process(params[MUTE_PARAM].getValue() > 0.f)) {
+            cause = BUTTON_CAUSE;
+        } else if (inputs[TRIGGER_MUTE_INPUT].getNormalVoltage(0.f) > 0.f) {
+            cause = TRIGGER_CAUSE;
+        } else {
+            return;
+        }
+
+        States from = state;
+        switch(state) {
+            case HIGH:
+                state = RAMP_DOWN;
+                fadeOutTime = rampTime();
+                fadeInTime = 0.f;
+                setLights(0.f, 0.9f, 0.f, 0.9f);
+                break;
+            case RAMP_UP:
+                state = RAMP_DOWN;
+                exchangeFades();
+                setLights(0.f, 0.9f, 0.f, 0.9f);
+                break;
+            case RAMP_DOWN:
+                state = RAMP_UP;
+                exchangeFades();
+                setLights(0.9f, 0.9f, 0.9f, 0.f);
+                break;
+            case LOW:
+                state = RAMP_UP;
+                fadeOutTime = rampTime();
+                fadeInTime = 0.f;
+                setLights(0.9f, 0.9f, 0.9f, 0.f);
+                break;
+            default:
+                printf("*** NO STATE WHEN TRIGGERED!\n");
+                return;
+        }
+        trace.record(from, state, cause);
+    }
+
+    // This is useful when we trigger a RAMP_UP from a RAMP_DOWN state
+    // and vice versa. We exchange fade-in and fade-out to (kind of)
+    // move backward.
+    void exchangeFades() {
+        float temp = fadeInTime;
+        fadeInTime = fadeOutTime;
+        fadeOutTime = temp;
+    }
+
+    // The time of the fade-in/out, as set by the user.
+    float rampTime() {
+        float time = params[FADE_PARAM].getValue();
+        int mult = (int) std::round(params[SCALE_PARAM].getValue());
+        switch(mult) {
+            case 1:
+                time *= 10;
+                break;
+            case 2:
+                time *= 100;
+                break;
+            default:
+                break;
+        }
+        return time;
+    }
+
+    // Play group 1, full amplitude.
+    void high() {
+        envelopes[0] = 1.f;
+        envelopes[1] = 0.f;
+    }
+
+    // Play group 2, full amplitude.
+    void low() {
+        envelopes[0] = 0.f;
+        envelopes[1] = 1.f;
+    }
+
+    // Fade-in the 2 inputs of a given group.
+    void rampUp(float sampleTime, int group) {
+        fadeInTime += sampleTime;
+        float userValue = rampTime();
+        float mult = fadeInTime / userValue;
+        mult = clamp(mult, 0.f, 1.f);
+
+        if (exponentialFade) {
+            mult = (*fadeTable)(mult);
+        }
+
+        envelopes[group] = mult;
+
+        if (fadeInTime >= userValue) {
+            if (state == RAMP_UP) {
+                trace.record(state, HIGH, FADE_END_CAUSE);
+                state = HIGH;
+                lights[RAMP_LIGHT].setBrightness(0.f);
+            }
+        }
+    }
+
+    // Fade-out the 2 inputs of a given group.
+    void rampDown(float sampleTime, int group) {
+        fadeOutTime -= sampleTime;
+        float userValue = rampTime();
+        float mult = fadeOutTime / userValue;
+        mult = clamp(mult, 0.f, 1.f);
+
+        if (exponentialFade) {
+            mult = (*fadeTable)(mult);
+        }
+
+        envelopes[group] = mult;
+
+        if (fadeOutTime <= 0.f) {
+            if (state == RAMP_DOWN) {
+                trace.record(state, LOW, FADE_END_CAUSE);
+                state = LOW;
+                lights[RAMP_LIGHT].setBrightness(0.f);
+            }
+        } else {
+            lights[RAMP_LIGHT].setBrightness(mult);
+        }
+    }
+
+    // sin(x * pi / 2) on [0, 1], odd polynomial fitted for the smallest
+    // maximum error (8e-5) and exact at 0 and 1.
+    static inline float_4 quarterSine(float_4 x) {
+        float_4 x2 = x * x;
+        return x * (1.5702429f + x2 * (-0.6417109f + x2 * 0.0714681f));
+    }
+
+    // While XFADE_CV_INPUT is connected, it sets the position between group 1
+    // (0 V) and group 2 (10 V), every sample. The fade is equal-power, and as
+    // cos(x) is sin(1 - x) in quarter turns, the gains of the four channels
+    // are one quarterSine() call. The button and the trigger are ignored.
+    void crossfadeByCv(float cv) {
+        crossfading = true;
+        float position = clamp(cv * 0.1f, 0.f, 1.f);
+        float_4 gains = quarterSine(float_4(1.f - position, 1.f - position,
+                                            position, position));
+
+        play(gains);
+
+        envelopes[0] = gains[0];
+        envelopes[1] = gains[2];
+        setLights(0.9f * gains[0], 0.f, 0.9f * gains[0], 0.9f * gains[2]);
+    }
+
+    json_t *dataToJson() override {
+        float value;
+        value = (state == HIGH || state == RAMP_UP) ? 1 : 0;
+        json_t *rootJ = json_object();
+        json_object_set_new(rootJ, "state", json_integer(value));
+        json_object_set_new(rootJ, "exponentialFade", json_integer((int) exponentialFade));
+        return rootJ;
+    }
+
+    void dataFromJson(json_t *rootJ) override {
+        json_t *stateJ = json_object_get(rootJ, "state");
+        if (stateJ) {
+            float value = json_integer_value(stateJ);
+            if (value == 1) {
+                state = HIGH;
+                setLights(0.9f, 0.f, 0.9f, 0.f);
+            } else {
+                state = LOW;
+                setLights(0.f, 0.f, 0.f, 0.9f);
+            }
+        }
+
+        json_t *exponentialFadeJ = json_object_get(rootJ, "exponentialFade");
+        if (exponentialFadeJ) {
+            exponentialFade = json_integer_value(exponentialFadeJ);
+        }
+    }
+};
@@ -1,4 +1,5 @@
 #include "plugin.hpp"
+#include "MixKernels.hpp"
 
 
 Plugin* pluginInstance;
@@ -12,6 +13,10 @@ void init(Plugin* p) {
 	p->addModel(modelDoubleMute);
 	p->addModel(modelTwoByTwo);
 	p->addModel(modelMatrixMixer4);
+	p->addModel(modelMultiMute);
+
+	selectMixKernels();
+	INFO("Using the %s mix kernels", mixKernels->name);
 
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
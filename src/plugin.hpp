@@ -1,5 +1,11 @@
 #pragma once
 #include <rack.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#if defined ARCH_WIN
+#include <malloc.h>
+#endif
 
 
 using namespace rack;
@@ -12,3 +18,64 @@ extern Plugin* pluginInstance;
 extern Model* modelDoubleMute;
 extern Model* modelTwoByTwo;
 extern Model* modelMatrixMixer4;
+extern Model* modelMultiMute;
+
+// Size of a cache line on the CPUs Rack runs on.
+static const size_t CACHE_LINE = 64;
+
+// Base for modules with members aligned on cache lines (alignas(CACHE_LINE)).
+// Their instances must start on a cache line too, which `new` only does
+// since C++17.
+struct CacheAligned {
+    static void* operator new(size_t size) {
+#if defined ARCH_WIN
+        void* p = _aligned_malloc(size, CACHE_LINE);
+#else
+        void* p = NULL;
+        if (posix_memalign(&p, CACHE_LINE, size) != 0) {
+            p = NULL;
+        }
+#endif
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    static void operator delete(void* p) {
+#if defined ARCH_WIN
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+};
+
+// Light filling the LEDBezel button of the mute modules.
+template <typename BASE>
+struct MuteLight : BASE {
+    MuteLight() {
+        this->box.size = mm2px(Vec(6.f, 6.f));
+    }
+};
+
+// Logs how long a module widget takes to build. Build with
+// `make FLAGS+=-DPROFILE_PANELS` to enable it.
+struct PanelTimer {
+#ifdef PROFILE_PANELS
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+
+    PanelTimer(const char* name) : name(name) {
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~PanelTimer() {
+        std::chrono::duration<double, std::micro> time =
+            std::chrono::steady_clock::now() - start;
+        INFO("%s panel built in %.0f us", name, time.count());
+    }
+#else
+    PanelTimer(const char* name) {}
+#endif
+};
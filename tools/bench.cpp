@@ -0,0 +1,345 @@
+// Engine thread scaling benchmark. Creates N instances of a module, one after
+// the other like when they are added to a patch, and processes them with 1 to
+// T threads, frame by frame, like the Rack engine: the threads wait on a
+// barrier before and after each frame, and take the next module from a shared
+// atomic index in between.
+//
+//     bench [--module NAME] [--instances N[,N...]] [--frames F] [--threads T]
+//           [--partition engine|interleaved] [--channels C]
+//           [--kernels SSE|AVX2|AVX-512]
+//
+// Without --module, all the modules are measured, for each instance count.
+// With --partition interleaved, instances are dealt to the threads in turn
+// instead, so neighbours always run on different threads: if their hot state
+// shared cache lines, it would show as poor scaling. The audio inputs carry C
+// channels (default 1), and the Matrix Mixer 4 uses the given MixKernels
+// instead of the widest ones the CPU runs.
+//
+// For each thread count, it prints the throughput, the cost per instance per
+// frame, the speedup over one thread and, where the kernel lets us count them
+// (Linux perf events), the cache misses per instance per frame. Then, for
+// each thread, the share of the instances it processed, the time it spent in
+// process() and the cost per instance.
+#include "modules.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+struct SpinBarrier {
+    int total;
+    std::atomic<int> count{0};
+    std::atomic<int> generation{0};
+
+    SpinBarrier(int total) : total(total) {}
+
+    void wait() {
+        int current = generation.load(std::memory_order_acquire);
+        if (count.fetch_add(1, std::memory_order_acq_rel) + 1 == total) {
+            count.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        while (generation.load(std::memory_order_acquire) == current) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+// Hardware cache misses of the calling thread, user space only, including
+// the barriers. Counts nothing where perf events aren't available.
+struct CacheMissCounter {
+    int fd = -1;
+
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    bool available() {
+        return fd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+};
+
+struct Options {
+    std::string module;
+    std::vector<int> instances = {128};
+    int frames = 48000;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool interleaved = false;
+    int channels = 1;
+};
+
+// What each thread measured, on its own cache line.
+struct alignas(CACHE_LINE) ThreadStats {
+    uint64_t processed = 0;
+    double busy = 0.0; // Seconds in process().
+    uint64_t cacheMisses = 0;
+    bool counted = false;
+};
+
+struct RunStats {
+    double wall = 0.0;
+    std::vector<ThreadStats> threads;
+};
+
+typedef std::vector<std::unique_ptr<Module>> Instances;
+
+static Instances createInstances(const ModuleSpec& spec, int count, int channels) {
+    Instances instances;
+    for (int i = 0; i < count; i++) {
+        Module* module = spec.create();
+        for (int id : spec.audioInputs) {
+            module->inputs[id].channels = channels;
+        }
+        for (int id : spec.audioOutputs) {
+            module->outputs[id].channels = 1;
+        }
+        module->onAdd();
+        instances.emplace_back(module);
+    }
+    return instances;
+}
+
+// Audio in, and a push on the first button (the mute button of Double Mute
+// and 2 x 2 Mute) now and then so the fades run too.
+static void feed(const ModuleSpec& spec, Module* module, int frame) {
+    float voltage = 5.f * std::sin(frame * 0.0575f);
+    for (int id : spec.audioInputs) {
+        for (int c = 0; c < module->inputs[id].channels; c++) {
+            module->inputs[id].setVoltage(voltage, c);
+        }
+    }
+    module->params[0].setValue((frame % 9600) < 10 ? 1.f : 0.f);
+}
+
+static RunStats run(const ModuleSpec& spec, Instances& instances, int frames,
+                    int threads, bool interleaved) {
+    Module::ProcessArgs args;
+    args.sampleRate = 48000.f;
+    args.sampleTime = 1.f / args.sampleRate;
+    SpinBarrier barrier(threads);
+    std::atomic<size_t> nextModule{0};
+    std::vector<ThreadStats> stats(threads);
+
+    auto worker = [&](int thread) {
+        ThreadStats& own = stats[thread];
+        CacheMissCounter cacheMisses;
+        cacheMisses.start();
+        std::chrono::duration<double> busy(0.0);
+
+        for (int frame = 0; frame < frames; frame++) {
+            // As the engine: the main thread resets the index, all the
+            // threads start together, and the frame ends when all are done.
+            if (thread == 0) {
+                nextModule.store(0, std::memory_order_relaxed);
+            }
+            barrier.wait();
+            auto start = std::chrono::steady_clock::now();
+            if (interleaved) {
+                for (size_t i = thread; i < instances.size(); i += threads) {
+                    feed(spec, instances[i].get(), frame);
+                    instances[i]->process(args);
+                    own.processed++;
+                }
+            } else {
+                size_t i;
+                while ((i = nextModule.fetch_add(1, std::memory_order_relaxed))
+                        < instances.size()) {
+                    feed(spec, instances[i].get(), frame);
+                    instances[i]->process(args);
+                    own.processed++;
+                }
+            }
+            busy += std::chrono::steady_clock::now() - start;
+            barrier.wait();
+        }
+
+        own.busy = busy.count();
+        own.cacheMisses = cacheMisses.stop();
+        own.counted = cacheMisses.available();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    RunStats result;
+    result.wall = elapsed.count();
+    result.threads = stats;
+    return result;
+}
+
+static void bench(const ModuleSpec& spec, int count, const Options& options) {
+    std::printf("%s, %d instances, %d frames, %d channels, %s kernels, %s\n",
+                spec.name, count, options.frames, options.channels,
+                mixKernels->name, options.interleaved ? "interleaved" : "engine");
+    std::printf("  threads  wall (s)  Minst-frames/s  ns/inst-frame  speedup"
+                "  efficiency  misses/inst-frame\n");
+
+    double work = (double) count * options.frames;
+    double single = 0.0;
+    for (int threads = 1; threads <= options.threads; threads *= 2) {
+        Instances instances = createInstances(spec, count, options.channels);
+        RunStats stats = run(spec, instances, options.frames, threads,
+                             options.interleaved);
+        if (threads == 1) {
+            single = stats.wall;
+        }
+
+        uint64_t misses = 0;
+        bool counted = true;
+        for (const ThreadStats& thread : stats.threads) {
+            misses += thread.cacheMisses;
+            counted = counted && thread.counted;
+        }
+        char missesText[32] = "n/a";
+        if (counted) {
+            std::snprintf(missesText, sizeof(missesText), "%.3f", misses / work);
+        }
+        std::printf("  %7d  %8.3f  %14.2f  %13.2f  %7.2f  %9.0f%%  %17s\n",
+                    threads, stats.wall, work / stats.wall / 1e6,
+                    1e9 * stats.wall / work, single / stats.wall,
+                    100.0 * single / stats.wall / threads, missesText);
+
+        for (int t = 0; t < threads; t++) {
+            const ThreadStats& thread = stats.threads[t];
+            std::printf("           thread %2d: %5.1f%% of the instances,"
+                        " busy %5.1f%%, %.2f ns/inst-frame\n",
+                        t, 100.0 * thread.processed / work,
+                        100.0 * thread.busy / stats.wall,
+                        thread.processed ? 1e9 * thread.busy / thread.processed : 0.0);
+        }
+
+        if (threads < options.threads && threads * 2 > options.threads) {
+            threads = options.threads / 2;
+        }
+    }
+}
+
+static std::vector<int> parseCounts(const std::string& list) {
+    std::vector<int> counts;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        counts.push_back(std::max(1, std::atoi(item.c_str())));
+    }
+    return counts;
+}
+
+// Prints how to call the benchmark, for main() to return.
+static int usage() {
+    std::fprintf(stderr,
+                 "usage: bench [--module NAME] [--instances N[,N...]] [--frames F] [--threads T]\n"
+                 "             [--partition engine|interleaved] [--channels C]\n"
+                 "             [--kernels SSE|AVX2|AVX-512]\n");
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    selectMixKernels();
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "bench: missing value for %s\n", option.c_str());
+            return usage();
+        }
+        std::string value = argv[i + 1];
+        if (option == "--module") {
+            if (!findModuleSpec(value)) {
+                std::fprintf(stderr, "bench: unknown module %s\n", value.c_str());
+                return usage();
+            }
+            options.module = value;
+        } else if (option == "--instances") {
+            options.instances = parseCounts(value);
+        } else if (option == "--frames") {
+            options.frames = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--threads") {
+            options.threads = std::max(1, std::atoi(value.c_str()));
+        } else if (option == "--partition") {
+            if (value != "engine" && value != "interleaved") {
+                std::fprintf(stderr, "bench: unknown partition %s\n", value.c_str());
+                return usage();
+            }
+            options.interleaved = (value == "interleaved");
+        } else if (option == "--channels") {
+            options.channels = clamp(std::atoi(value.c_str()), 1, PORT_MAX_CHANNELS);
+        } else if (option == "--kernels") {
+            mixKernels = findMixKernels(value);
+            if (!mixKernels) {
+                std::fprintf(stderr, "bench: no %s kernels on this CPU\n", value.c_str());
+                return usage();
+            }
+        } else {
+            std::fprintf(stderr, "bench: unknown option %s\n", option.c_str());
+            return usage();
+        }
+    }
+
+    for (const ModuleSpec& spec : moduleSpecs()) {
+        if (!options.module.empty() && options.module != spec.name) {
+            continue;
+        }
+        for (int count : options.instances) {
+            bench(spec, count, options);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+// The modules the headless tools know about, and their audio ports.
+#include "DoubleMute.hpp"
+#include "TwoByTwo.hpp"
+#include "MatrixMixer4.hpp"
+#include "MultiMute.hpp"
+#include "MixKernels.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+
+struct ModuleSpec {
+    const char* name;
+    std::function<Module*()> create;
+    std::vector<int> audioInputs;
+    std::vector<int> audioOutputs;
+    // The largest gain from the audio inputs to an audio output.
+    float maxGain;
+    // Sets one of the context menu options, picked with a random number.
+    std::function<void(Module*, uint32_t)> chooseMenuItem;
+    // What is wrong with the state of the module, or NULL. May be empty.
+    std::function<const char*(Module*)> checkState;
+};
+
+inline const std::vector<ModuleSpec>& moduleSpecs() {
+    static const std::vector<ModuleSpec> specs = {
+        {"DoubleMute", [] { return new DoubleMute(); },
+         {DoubleMute::IN1_INPUT, DoubleMute::IN2_INPUT},
+         {DoubleMute::OUT1_OUTPUT, DoubleMute::OUT2_OUTPUT},
+         1.f,
+         [](Module* module, uint32_t choice) {
+             static_cast<DoubleMute*>(module)->exponentialFade = choice & 1;
+         }},
+        {"TwoByTwo", [] { return new TwoByTwo(); },
+         {TwoByTwo::IN_INPUTS + 0, TwoByTwo::IN_INPUTS + 1,
+          TwoByTwo::IN_INPUTS + 2, TwoByTwo::IN_INPUTS + 3},
+         {TwoByTwo::OUT_OUTPUTS + 0, TwoByTwo::OUT_OUTPUTS + 1,
+          TwoByTwo::OUT_OUTPUTS + 2, TwoByTwo::OUT_OUTPUTS + 3},
+         1.f,
+         [](Module* module, uint32_t choice) {
+             static_cast<TwoByTwo*>(module)->exponentialFade = choice & 1;
+         }},
+        {"MatrixMixer4", [] { return new MatrixMixer4(); },
+         {MatrixMixer4::IN_INPUTS + 0, MatrixMixer4::IN_INPUTS + 1,
+          MatrixMixer4::IN_INPUTS + 2, MatrixMixer4::IN_INPUTS + 3},
+         {MatrixMixer4::OUT_OUTPUTS + 0, MatrixMixer4::OUT_OUTPUTS + 1,
+          MatrixMixer4::OUT_OUTPUTS + 2, MatrixMixer4::OUT_OUTPUTS + 3},
+         // 4 inputs, with trims, masters and pans at their highest.
+         4.f * 2.f * 2.f * float(M_SQRT2),
+         [](Module* module, uint32_t choice) {
+             MatrixMixer4* mixer = static_cast<MatrixMixer4*>(module);
+             switch (choice % 4) {
+                 case 0: mixer->amplitudeAlgorithm = (choice >> 2) % 4; break;
+                 case 1:
+                     mixer->pendingMuteAlgorithm = (choice >> 2) % NUM_MUTE_ALGORITHMS + 1;
+                     break;
+                 case 2: mixer->potCvMode = (choice >> 2) % 2; break;
+                 case 3: mixer->stereo = (choice >> 2) % 2; break;
+             }
+         },
+         [](Module* module) -> const char* {
+             MatrixMixer4* mixer = static_cast<MatrixMixer4*>(module);
+             if (!mixer->currentMuteAlgorithm().exclusiveRows) {
+                 return NULL;
+             }
+             if (mixer->rowMask & (mixer->rowMask - 1)) {
+                 return "several rows unmuted with Exclusive rows";
+             }
+             if (mixer->ledMask & ~MatrixMixer4::rowsToLeds(mixer->rowMask)) {
+                 return "a pot unmuted outside the row with Exclusive rows";
+             }
+             return NULL;
+         }},
+        {"MultiMute", [] { return new MultiMute(); },
+         {MultiMute::IN_INPUTS + 0, MultiMute::IN_INPUTS + 1,
+          MultiMute::IN_INPUTS + 2, MultiMute::IN_INPUTS + 3,
+          MultiMute::IN_INPUTS + 4, MultiMute::IN_INPUTS + 5,
+          MultiMute::IN_INPUTS + 6, MultiMute::IN_INPUTS + 7},
+         {MultiMute::OUT_OUTPUTS + 0, MultiMute::OUT_OUTPUTS + 1,
+          MultiMute::OUT_OUTPUTS + 2, MultiMute::OUT_OUTPUTS + 3,
+          MultiMute::OUT_OUTPUTS + 4, MultiMute::OUT_OUTPUTS + 5,
+          MultiMute::OUT_OUTPUTS + 6, MultiMute::OUT_OUTPUTS + 7},
+         1.f,
+         [](Module* module, uint32_t choice) {
+             MultiMute* mute = static_cast<MultiMute*>(module);
+             mute->exponentialFades[choice % MultiMute::LANES] = (choice >> 3) & 1;
+         }},
+    };
+    return specs;
+}
+
+// The MixKernels variant of that name, if this CPU runs it.
+inline const MixKernels* findMixKernels(const std::string& name) {
+    __builtin_cpu_init();
+    for (const MixKernels* kernels : ALL_MIX_KERNELS) {
+        if (name == kernels->name && kernels->supported()) {
+            return kernels;
+        }
+    }
+    return NULL;
+}
+
+inline const ModuleSpec* findModuleSpec(const std::string& name) {
+    for (const ModuleSpec& spec : moduleSpecs()) {
+        if (name == spec.name) {
+            return &spec;
+        }
+    }
+    return NULL;
+}
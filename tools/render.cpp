@@ -0,0 +1,213 @@
+// Offline renderer: streams a WAV file through one of the modules, exactly
+// as Rack would run it, and writes the outputs to another WAV file.
+//
+//     render MODULE IN.wav OUT.wav [options]
+//
+// MODULE is DoubleMute, TwoByTwo, MatrixMixer4 or MultiMute. The channels of
+// IN.wav go to the audio inputs of the module, in order, as mono cables, and
+// the audio outputs go to the channels of OUT.wav. Samples are scaled like
+// the Rack Audio module: full scale is 10 V. The outputs are rendered mono:
+// if one of them gets several channels (polyphonic or stereo mixing), the
+// render stops with an error rather than drop all but the first.
+//
+// Options:
+//     --param ID=VALUE    Set a parameter before rendering.
+//     --script FILE       Events to apply while rendering, one per line:
+//                             SECONDS param ID VALUE
+//                             SECONDS trigger ID    (push a button)
+//                             SECONDS cv ID VOLTAGE (set an input)
+//                         Lines starting with # are ignored.
+//     --block FRAMES      Frames read and written at once (default 4096).
+//
+// IDs are the indexes of the ParamIds and InputIds enums of the module.
+#include "modules.hpp"
+#include "wav.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+
+struct Event {
+    enum Type {
+        PARAM,
+        TRIGGER,
+        CV
+    };
+
+    uint64_t frame;
+    Type type;
+    int id;
+    float value;
+};
+
+static void fail(const std::string& message) {
+    std::fprintf(stderr, "render: %s\n", message.c_str());
+    std::exit(1);
+}
+
+static std::vector<Event> readScript(const char* path, int sampleRate) {
+    std::ifstream file(path);
+    if (!file) {
+        fail(std::string("cannot open ") + path);
+    }
+
+    std::vector<Event> events;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream words(line);
+        double seconds;
+        std::string type;
+        Event event;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (!(words >> seconds >> type >> event.id)) {
+            fail(std::string(path) + ":" + std::to_string(lineNumber) + ": bad event");
+        }
+        event.frame = (uint64_t) std::llround(seconds * sampleRate);
+        event.value = 0.f;
+        if (type == "param") {
+            event.type = Event::PARAM;
+            words >> event.value;
+        } else if (type == "trigger") {
+            event.type = Event::TRIGGER;
+        } else if (type == "cv") {
+            event.type = Event::CV;
+            words >> event.value;
+        } else {
+            fail(std::string(path) + ":" + std::to_string(lineNumber) + ": unknown event " + type);
+        }
+        events.push_back(event);
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.frame < b.frame;
+    });
+    return events;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fail("usage: render MODULE IN.wav OUT.wav [--param ID=VALUE] "
+             "[--script FILE] [--block FRAMES]");
+    }
+
+    selectMixKernels();
+
+    const ModuleSpec* spec = findModuleSpec(argv[1]);
+    if (!spec) {
+        fail(std::string("unknown module ") + argv[1]);
+    }
+
+    WavReader reader;
+    std::string error = reader.open(argv[2]);
+    if (!error.empty()) {
+        fail(std::string(argv[2]) + ": " + error);
+    }
+
+    std::unique_ptr<Module> module(spec->create());
+    std::vector<Event> events;
+    size_t blockSize = 4096;
+    for (int i = 4; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            fail("missing value for " + option);
+        }
+        std::string value = argv[++i];
+        if (option == "--param") {
+            size_t equal = value.find('=');
+            int id = std::atoi(value.substr(0, equal).c_str());
+            if (equal == std::string::npos || id < 0 || id >= (int) module->params.size()) {
+                fail("bad parameter " + value);
+            }
+            module->params[id].setValue(std::atof(value.substr(equal + 1).c_str()));
+        } else if (option == "--script") {
+            events = readScript(value.c_str(), reader.sampleRate);
+        } else if (option == "--block") {
+            blockSize = std::max(1, std::atoi(value.c_str()));
+        } else {
+            fail("unknown option " + option);
+        }
+    }
+    for (const Event& event : events) {
+        int count = (event.type == Event::CV) ? module->inputs.size()
+                                              : module->params.size();
+        if (event.id < 0 || event.id >= count) {
+            fail("event for a missing parameter or input " + std::to_string(event.id));
+        }
+    }
+
+    int inputChannels = std::min<int>(reader.channels, spec->audioInputs.size());
+    int outputChannels = spec->audioOutputs.size();
+    for (int i = 0; i < inputChannels; i++) {
+        module->inputs[spec->audioInputs[i]].channels = 1;
+    }
+    for (int id : spec->audioOutputs) {
+        module->outputs[id].channels = 1;
+    }
+
+    WavWriter writer;
+    if (!writer.open(argv[3], outputChannels, reader.sampleRate)) {
+        fail(std::string("cannot write ") + argv[3]);
+    }
+
+    Module::ProcessArgs args;
+    args.sampleRate = reader.sampleRate;
+    args.sampleTime = 1.f / reader.sampleRate;
+    module->onAdd();
+
+    std::vector<float> in(blockSize * reader.channels);
+    std::vector<float> out(blockSize * outputChannels);
+    std::vector<int> releases; // Buttons pushed on the previous frame.
+    size_t nextEvent = 0;
+    uint64_t frame = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    while (size_t count = reader.read(in.data(), blockSize)) {
+        for (size_t f = 0; f < count; f++, frame++) {
+            for (int id : releases) {
+                module->params[id].setValue(0.f);
+            }
+            releases.clear();
+            for (; nextEvent < events.size() && events[nextEvent].frame <= frame; nextEvent++) {
+                const Event& event = events[nextEvent];
+                if (event.type == Event::PARAM) {
+                    module->params[event.id].setValue(event.value);
+                } else if (event.type == Event::TRIGGER) {
+                    module->params[event.id].setValue(1.f);
+                    releases.push_back(event.id);
+                } else {
+                    module->inputs[event.id].channels = 1;
+                    module->inputs[event.id].setVoltage(event.value);
+                }
+            }
+
+            for (int i = 0; i < inputChannels; i++) {
+                module->inputs[spec->audioInputs[i]].setVoltage(
+                    10.f * in[f * reader.channels + i]);
+            }
+            module->process(args);
+            for (int i = 0; i < outputChannels; i++) {
+                Output& output = module->outputs[spec->audioOutputs[i]];
+                if (output.getChannels() > 1) {
+                    fail("output " + std::to_string(spec->audioOutputs[i]) + " has " +
+                         std::to_string(output.getChannels()) + " channels at frame " +
+                         std::to_string(frame) + ", only mono outputs can be rendered");
+                }
+                out[f * outputChannels + i] = output.getVoltage() / 10.f;
+            }
+        }
+        writer.write(out.data(), count);
+    }
+    writer.close();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double duration = (double) frame / reader.sampleRate;
+    std::fprintf(stderr, "%s: %.2f s of audio in %.3f s, %.1fx real time\n",
+                 spec->name, duration, elapsed.count(), duration / elapsed.count());
+    return 0;
+}
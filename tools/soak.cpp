@@ -0,0 +1,545 @@
+// Soak test: runs each module through hours of simulated audio under random
+// trigger storms, param sweeps and connection changes, times every call to
+// process(), and checks every output sample.
+//
+//     soak [--module NAME] [--seed S] [--hours H]
+//
+// Everything comes from the seed (default 1): the same seed gives the same
+// events and the same outputs, so a problem found once can be replayed. Each
+// module draws from its own sequence, so --module doesn't change what it
+// gets. Over a run, at random times:
+//   - storms: for 1 to 64 frames, up to 4 events per frame among button
+//     pushes and gates, so that rows, columns, fades... are toggled together,
+//   - pushes: a param goes to its maximum for up to 100 ms, then back to its
+//     minimum, like a button,
+//   - jumps: a param goes to a random value,
+//   - sweeps: a param moves to a random value in up to 1 s,
+//   - gates and CV: an input goes between 0 and 10 V, or to a random voltage
+//     on each of its channels,
+//   - connections: an input is unplugged, or plugged with 1 to 16 channels,
+//     an output is unplugged or plugged,
+//   - menu: a context menu option changes,
+//   - sample rate changes, between 44.1 and 192 kHz.
+// The audio inputs carry noise of 5 V peak.
+//
+// For each module, it prints the cost of process() per sample: p50, p99,
+// p99.9 and max, what happened in the frame of the max, and the worst frame
+// with events (the max is often the system busy elsewhere). Output samples
+// which aren't finite, or louder than the audio inputs allow (12 V for the
+// outputs which aren't audio), are reported, and the exit status is 1. So are
+// the frames which end in a state the module must never be in, such as
+// MatrixMixer4 with several rows unmuted in Exclusive rows.
+#include "modules.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <x86intrin.h>
+
+
+static const float AUDIO_PEAK = 5.f;
+static const float CV_LIMIT = 12.f;
+static const int NOISE_SIZE = 1 << 16;
+static const int MAX_REPORTED_PROBLEMS = 10;
+
+// SplitMix64: the same numbers everywhere, unlike the distributions of
+// <random>.
+struct Random {
+    uint64_t state;
+
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // From 0 to n - 1.
+    uint32_t below(uint32_t n) {
+        return (uint32_t) (((next() >> 32) * n) >> 32);
+    }
+
+    float uniform(float a, float b) {
+        return a + (b - a) * ((next() >> 40) * (1.f / 16777216.f));
+    }
+};
+
+// Costs in TSC cycles, in buckets a 16th of an octave wide: the percentiles
+// are within about 4%, the max is exact.
+struct CostHistogram {
+    static const int SUB_BUCKETS = 16;
+
+    std::vector<uint64_t> counts = std::vector<uint64_t>(64 * SUB_BUCKETS);
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    static int bucket(uint64_t cycles) {
+        if (cycles < SUB_BUCKETS) {
+            return (int) cycles;
+        }
+        int octave = 63 - __builtin_clzll(cycles);
+        int sub = (cycles >> (octave - 4)) & (SUB_BUCKETS - 1);
+        return (octave - 3) * SUB_BUCKETS + sub;
+    }
+
+    static double middle(int bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        int octave = bucket / SUB_BUCKETS + 3;
+        uint64_t low = (uint64_t) (SUB_BUCKETS + bucket % SUB_BUCKETS) << (octave - 4);
+        return low + 0.5 * (1ull << (octave - 4));
+    }
+
+    void add(uint64_t cycles) {
+        counts[bucket(cycles)]++;
+        total++;
+        max = std::max(max, cycles);
+    }
+
+    double percentile(double p) const {
+        uint64_t rank = (uint64_t) std::ceil(p * total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank && seen > 0) {
+                return std::min(middle(i), (double) max);
+            }
+        }
+        return max;
+    }
+};
+
+static inline uint64_t readCycles() {
+    _mm_lfence();
+    uint64_t cycles = __rdtsc();
+    _mm_lfence();
+    return cycles;
+}
+
+// What the timing of a call costs by itself, taken off every measure.
+static uint64_t timingOverhead() {
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < 10000; i++) {
+        uint64_t start = readCycles();
+        overhead = std::min(overhead, readCycles() - start);
+    }
+    return overhead;
+}
+
+static bool isFinite(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7f800000) != 0x7f800000;
+}
+
+enum EventKinds {
+    STORM,
+    PUSH,
+    JUMP,
+    SWEEP,
+    GATE,
+    CV,
+    CONNECTION,
+    MENU,
+    SAMPLE_RATE,
+    NUM_EVENT_KINDS
+};
+
+static const char* const EVENT_NAMES[NUM_EVENT_KINDS] = {
+    "storm", "push", "jump", "sweep", "gate", "cv", "connection", "menu",
+    "sample rate"
+};
+
+struct Options {
+    std::string module;
+    uint64_t seed = 1;
+    double hours = 1.0;
+};
+
+struct Soak {
+    struct Release {
+        uint64_t frame;
+        int param;
+    };
+
+    struct Sweep {
+        int param;
+        float step;
+        int frames;
+    };
+
+    const ModuleSpec& spec;
+    Random random;
+    std::unique_ptr<Module> module;
+    Module::ProcessArgs args;
+    std::vector<float> noise;
+    std::vector<bool> audioInput;
+    std::vector<bool> audioOutput;
+    std::vector<int> cvInputs;
+    std::vector<Release> releases;
+    std::vector<Sweep> sweeps;
+    int stormFrames = 0;
+    uint64_t frame = 0;
+    double time = 0.0;
+    int events = 0; // Mask of the EventKinds of the current frame.
+    uint64_t eventCount = 0;
+
+    CostHistogram costs;
+    double maxTime = 0.0;
+    int maxEvents = 0;
+    // The max is often the system taking the CPU away, while the worst frame
+    // with events tells the rare paths of the module.
+    uint64_t maxEventCost = 0;
+    double maxEventTime = 0.0;
+    int maxEventEvents = 0;
+    uint64_t problems = 0;
+    uint64_t stateProblems = 0;
+
+    Soak(const ModuleSpec& spec, uint64_t seed)
+            : spec(spec), random(seed), module(spec.create()) {
+        for (int i = 0; i < NOISE_SIZE; i++) {
+            noise.push_back(random.uniform(-AUDIO_PEAK, AUDIO_PEAK));
+        }
+        audioInput.resize(module->inputs.size());
+        audioOutput.resize(module->outputs.size());
+        for (int id : spec.audioInputs) {
+            audioInput[id] = true;
+            module->inputs[id].channels = 1;
+        }
+        for (int id = 0; id < (int) module->inputs.size(); id++) {
+            if (!audioInput[id]) {
+                cvInputs.push_back(id);
+            }
+        }
+        for (int id : spec.audioOutputs) {
+            audioOutput[id] = true;
+        }
+        for (Output& output : module->outputs) {
+            output.channels = 1;
+        }
+        setSampleRate(48000.f);
+        module->onAdd();
+    }
+
+    void setSampleRate(float sampleRate) {
+        args.sampleRate = sampleRate;
+        args.sampleTime = 1.f / sampleRate;
+        module->onSampleRateChange();
+    }
+
+    int randomParam() {
+        return random.below(module->params.size());
+    }
+
+    // The params are a stand-in for the knobs and buttons, and so go from
+    // the minimum to the maximum of their ParamQuantity.
+    void setParam(int id, float value) {
+        ParamQuantity* quantity = module->paramQuantities[id];
+        module->params[id].setValue(clamp(value, quantity->minValue, quantity->maxValue));
+    }
+
+    void push() {
+        int id = randomParam();
+        setParam(id, module->paramQuantities[id]->maxValue);
+        releases.push_back({frame + 1 + random.below((uint32_t) (args.sampleRate * 0.1f)), id});
+    }
+
+    void gate() {
+        if (cvInputs.empty()) {
+            return;
+        }
+        Input& input = module->inputs[cvInputs[random.below(cvInputs.size())]];
+        float voltage = (input.getVoltage() > 0.f) ? 0.f : 10.f;
+        for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+            input.setVoltage(voltage, c);
+        }
+    }
+
+    void cv() {
+        if (cvInputs.empty()) {
+            return;
+        }
+        Input& input = module->inputs[cvInputs[random.below(cvInputs.size())]];
+        for (int c = 0; c < PORT_MAX_CHANNELS; c++) {
+            input.setVoltage(random.uniform(-10.f, 10.f), c);
+        }
+    }
+
+    void connection() {
+        uint32_t id = random.below(module->inputs.size() + module->outputs.size());
+        if (id < module->inputs.size()) {
+            uint32_t kind = random.below(3);
+            module->inputs[id].channels = (kind == 2) ? 2 + random.below(15) : kind;
+        } else {
+            Output& output = module->outputs[id - module->inputs.size()];
+            output.channels = output.isConnected() ? 0 : 1;
+        }
+    }
+
+    void apply(EventKinds kind) {
+        events |= 1 << kind;
+        eventCount++;
+        switch (kind) {
+            case STORM:
+                stormFrames = 1 + random.below(64);
+                break;
+            case PUSH:
+                push();
+                break;
+            case JUMP: {
+                int id = randomParam();
+                ParamQuantity* quantity = module->paramQuantities[id];
+                setParam(id, random.uniform(quantity->minValue, quantity->maxValue));
+                break;
+            }
+            case SWEEP: {
+                int id = randomParam();
+                ParamQuantity* quantity = module->paramQuantities[id];
+                int frames = 1 + random.below((uint32_t) args.sampleRate);
+                float target = random.uniform(quantity->minValue, quantity->maxValue);
+                sweeps.push_back({id, (target - module->params[id].getValue()) / frames, frames});
+                break;
+            }
+            case GATE:
+                gate();
+                break;
+            case CV:
+                cv();
+                break;
+            case CONNECTION:
+                connection();
+                break;
+            case MENU:
+                spec.chooseMenuItem(module.get(), (uint32_t) random.next());
+                break;
+            case SAMPLE_RATE: {
+                static const float RATES[] = {44100.f, 48000.f, 96000.f, 192000.f};
+                setSampleRate(RATES[random.below(4)]);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // About 25 events per second, a storm every 5 seconds.
+    void schedule() {
+        events = 0;
+        if (stormFrames > 0) {
+            stormFrames--;
+            events |= 1 << STORM;
+            for (int n = 1 + random.below(4); n > 0; n--) {
+                apply(random.below(2) ? PUSH : GATE);
+            }
+        }
+        if (random.below((uint32_t) (args.sampleRate / 25.f)) == 0) {
+            uint32_t pick = random.below(1000);
+            if (pick < 8) {
+                apply(STORM);
+            } else if (pick < 300) {
+                apply(PUSH);
+            } else if (pick < 450) {
+                apply(JUMP);
+            } else if (pick < 550) {
+                apply(SWEEP);
+            } else if (pick < 750) {
+                apply(GATE);
+            } else if (pick < 850) {
+                apply(CV);
+            } else if (pick < 960) {
+                apply(CONNECTION);
+            } else if (pick < 995) {
+                apply(MENU);
+            } else {
+                apply(SAMPLE_RATE);
+            }
+        }
+
+        for (size_t i = 0; i < releases.size();) {
+            if (releases[i].frame <= frame) {
+                setParam(releases[i].param,
+                         module->paramQuantities[releases[i].param]->minValue);
+                releases[i] = releases.back();
+                releases.pop_back();
+            } else {
+                i++;
+            }
+        }
+        for (size_t i = 0; i < sweeps.size();) {
+            Sweep& sweep = sweeps[i];
+            setParam(sweep.param, module->params[sweep.param].getValue() + sweep.step);
+            if (--sweep.frames == 0) {
+                sweeps[i] = sweeps.back();
+                sweeps.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void feed() {
+        for (int id : spec.audioInputs) {
+            Input& input = module->inputs[id];
+            for (int c = 0; c < input.getChannels(); c++) {
+                input.setVoltage(noise[(frame + 4099 * c + 257 * id) & (NOISE_SIZE - 1)], c);
+            }
+        }
+    }
+
+    void check() {
+        float audioLimit = AUDIO_PEAK * spec.maxGain * 1.001f;
+        for (int id = 0; id < (int) module->outputs.size(); id++) {
+            Output& output = module->outputs[id];
+            float limit = audioOutput[id] ? audioLimit : CV_LIMIT;
+            for (int c = 0; c < output.getChannels(); c++) {
+                float voltage = output.getVoltage(c);
+                if (isFinite(voltage) && std::abs(voltage) <= limit) {
+                    continue;
+                }
+                if (problems < MAX_REPORTED_PROBLEMS) {
+                    std::printf("  %s: output %d channel %d is %g V at %.6f s"
+                                " (frame %llu)\n",
+                                isFinite(voltage) ? "out of range" : "not finite",
+                                id, c + 1, voltage, time, (unsigned long long) frame);
+                }
+                problems++;
+            }
+        }
+
+        const char* problem = spec.checkState ? spec.checkState(module.get()) : NULL;
+        if (problem) {
+            if (stateProblems < MAX_REPORTED_PROBLEMS) {
+                std::printf("  bad state: %s at %.6f s (frame %llu)\n", problem, time,
+                            (unsigned long long) frame);
+            }
+            stateProblems++;
+        }
+    }
+
+    void run(double seconds, uint64_t overhead) {
+        while (time < seconds) {
+            schedule();
+            feed();
+
+            uint64_t start = readCycles();
+            module->process(args);
+            uint64_t elapsed = readCycles() - start;
+            elapsed -= std::min(elapsed, overhead);
+
+            if (elapsed > costs.max) {
+                maxTime = time;
+                maxEvents = events;
+            }
+            if (events && elapsed > maxEventCost) {
+                maxEventCost = elapsed;
+                maxEventTime = time;
+                maxEventEvents = events;
+            }
+            costs.add(elapsed);
+            check();
+            frame++;
+            time += args.sampleTime;
+        }
+    }
+};
+
+static std::string describeEvents(int events) {
+    std::string text;
+    for (int kind = 0; kind < NUM_EVENT_KINDS; kind++) {
+        if (events & (1 << kind)) {
+            text += text.empty() ? "" : ", ";
+            text += EVENT_NAMES[kind];
+        }
+    }
+    return text.empty() ? "no event" : text;
+}
+
+// Each module gets its own sequence, whatever the others run.
+static uint64_t moduleSeed(uint64_t seed, const char* name) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char* c = name; *c; c++) {
+        hash = (hash ^ (uint8_t) *c) * 0x100000001b3ull;
+    }
+    return seed ^ hash;
+}
+
+static uint64_t soak(const ModuleSpec& spec, const Options& options, uint64_t overhead) {
+    std::printf("%s, seed %llu, %.2f h of audio\n", spec.name,
+                (unsigned long long) options.seed, options.hours);
+    std::fflush(stdout);
+
+    Soak soak(spec, moduleSeed(options.seed, spec.name));
+    auto start = std::chrono::steady_clock::now();
+    uint64_t startCycles = readCycles();
+    soak.run(options.hours * 3600.0, overhead);
+    uint64_t cycles = readCycles() - startCycles;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double nsPerCycle = 1e9 * elapsed.count() / cycles;
+
+    const CostHistogram& costs = soak.costs;
+    std::printf("  %llu frames, %llu events, in %.1f s\n",
+                (unsigned long long) soak.frame, (unsigned long long) soak.eventCount,
+                elapsed.count());
+    std::printf("  ns/sample: p50 %.0f, p99 %.0f, p99.9 %.0f, max %.0f\n",
+                costs.percentile(0.5) * nsPerCycle, costs.percentile(0.99) * nsPerCycle,
+                costs.percentile(0.999) * nsPerCycle, costs.max * nsPerCycle);
+    std::printf("  max at %.6f s, frame events: %s\n", soak.maxTime,
+                describeEvents(soak.maxEvents).c_str());
+    std::printf("  max with events %.0f ns at %.6f s: %s\n",
+                soak.maxEventCost * nsPerCycle, soak.maxEventTime,
+                describeEvents(soak.maxEventEvents).c_str());
+    if (soak.problems) {
+        std::printf("  %llu output samples not finite or out of range\n",
+                    (unsigned long long) soak.problems);
+    } else {
+        std::printf("  all the outputs finite and in range\n");
+    }
+    if (soak.stateProblems) {
+        std::printf("  %llu frames in a bad state\n",
+                    (unsigned long long) soak.stateProblems);
+    }
+    return soak.problems + soak.stateProblems;
+}
+
+static int usage() {
+    std::fprintf(stderr, "usage: soak [--module NAME] [--seed S] [--hours H]\n");
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    selectMixKernels();
+    Options options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "soak: missing value for %s\n", option.c_str());
+            return usage();
+        }
+        std::string value = argv[i + 1];
+        if (option == "--module") {
+            if (!findModuleSpec(value)) {
+                std::fprintf(stderr, "soak: unknown module %s\n", value.c_str());
+                return usage();
+            }
+            options.module = value;
+        } else if (option == "--seed") {
+            options.seed = std::strtoull(value.c_str(), NULL, 10);
+        } else if (option == "--hours") {
+            options.hours = std::max(0.0, std::atof(value.c_str()));
+        } else {
+            std::fprintf(stderr, "soak: unknown option %s\n", option.c_str());
+            return usage();
+        }
+    }
+
+    uint64_t overhead = timingOverhead();
+    uint64_t problems = 0;
+    for (const ModuleSpec& spec : moduleSpecs()) {
+        if (options.module.empty() || options.module == spec.name) {
+            problems += soak(spec, options, overhead);
+        }
+    }
+    return problems ? 1 : 0;
+}
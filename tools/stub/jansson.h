@@ -0,0 +1,113 @@
+#pragma once
+// Header-only subset of the jansson API, enough for the modules'
+// dataToJson()/dataFromJson() to compile and round-trip in the headless tools.
+#include <map>
+#include <string>
+#include <vector>
+
+
+enum json_type {
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_INTEGER,
+    JSON_REAL,
+    JSON_TRUE,
+    JSON_FALSE
+};
+
+struct json_t {
+    json_type type;
+    long long integer = 0;
+    double real = 0.0;
+    std::map<std::string, json_t*> object;
+    std::vector<json_t*> array;
+
+    json_t(json_type type) : type(type) {}
+    ~json_t() {
+        for (auto& it : object) {
+            delete it.second;
+        }
+        for (json_t* v : array) {
+            delete v;
+        }
+    }
+};
+
+inline json_t* json_object() {
+    return new json_t(JSON_OBJECT);
+}
+
+inline json_t* json_array() {
+    return new json_t(JSON_ARRAY);
+}
+
+inline json_t* json_integer(long long value) {
+    json_t* j = new json_t(JSON_INTEGER);
+    j->integer = value;
+    return j;
+}
+
+inline json_t* json_real(double value) {
+    json_t* j = new json_t(JSON_REAL);
+    j->real = value;
+    return j;
+}
+
+inline json_t* json_boolean(bool value) {
+    return new json_t(value ? JSON_TRUE : JSON_FALSE);
+}
+
+inline void json_decref(json_t* json) {
+    delete json;
+}
+
+inline int json_object_set_new(json_t* object, const char* key, json_t* value) {
+    auto it = object->object.find(key);
+    if (it != object->object.end()) {
+        delete it->second;
+    }
+    object->object[key] = value;
+    return 0;
+}
+
+inline json_t* json_object_get(const json_t* object, const char* key) {
+    if (!object || object->type != JSON_OBJECT) {
+        return NULL;
+    }
+    auto it = object->object.find(key);
+    return (it == object->object.end()) ? NULL : it->second;
+}
+
+inline int json_array_append_new(json_t* array, json_t* value) {
+    array->array.push_back(value);
+    return 0;
+}
+
+inline json_t* json_array_get(const json_t* array, size_t index) {
+    if (!array || array->type != JSON_ARRAY || index >= array->array.size()) {
+        return NULL;
+    }
+    return array->array[index];
+}
+
+inline size_t json_array_size(const json_t* array) {
+    return (array && array->type == JSON_ARRAY) ? array->array.size() : 0;
+}
+
+inline long long json_integer_value(const json_t* json) {
+    return (json && json->type == JSON_INTEGER) ? json->integer : 0;
+}
+
+inline double json_real_value(const json_t* json) {
+    return (json && json->type == JSON_REAL) ? json->real : 0.0;
+}
+
+inline double json_number_value(const json_t* json) {
+    if (!json) {
+        return 0.0;
+    }
+    return (json->type == JSON_INTEGER) ? (double) json->integer : json_real_value(json);
+}
+
+#define json_boolean_value(json) ((json) && (json)->type == JSON_TRUE)
+#define json_is_true(json) ((json) && (json)->type == JSON_TRUE)
@@ -0,0 +1,425 @@
+#pragma once
+// Minimal stand-in for the parts of the Rack v1 engine API used by the
+// module structs in src/*.hpp. This is what lets the headless tools run the
+// exact plugin DSP without Rack. Keep the signatures in sync with the SDK.
+// The few widget helpers plugin.hpp defines only need Vec and mm2px.
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <pmmintrin.h>
+
+#include "jansson.h"
+
+
+#define ENUMS(name, count) name, name ## _LAST = name + (count) - 1
+
+#define DEBUG(format, ...) std::fprintf(stderr, "[debug] " format "\n", ##__VA_ARGS__)
+#define INFO(format, ...) std::fprintf(stderr, "[info] " format "\n", ##__VA_ARGS__)
+#define WARN(format, ...) std::fprintf(stderr, "[warn] " format "\n", ##__VA_ARGS__)
+
+
+namespace rack {
+
+namespace math {
+
+inline int clamp(int x, int a, int b) {
+    return std::max(std::min(x, b), a);
+}
+
+inline float clamp(float x, float a, float b) {
+    return std::fmax(std::fmin(x, b), a);
+}
+
+inline float rescale(float x, float xMin, float xMax, float yMin, float yMax) {
+    return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+}
+
+inline float crossfade(float a, float b, float p) {
+    return a + (b - a) * p;
+}
+
+struct Vec {
+    float x = 0.f;
+    float y = 0.f;
+
+    Vec() {}
+    Vec(float x, float y) : x(x), y(y) {}
+    Vec mult(float s) const {
+        return Vec(x * s, y * s);
+    }
+};
+
+} // namespace math
+
+namespace simd {
+
+template <typename T, int N>
+struct Vector;
+
+template <>
+struct Vector<float, 4> {
+    using type = float;
+    constexpr static int size = 4;
+
+    union {
+        __m128 v;
+        float s[4];
+    };
+
+    Vector() = default;
+    Vector(__m128 v) : v(v) {}
+    Vector(float x) {
+        v = _mm_set1_ps(x);
+    }
+    Vector(float x1, float x2, float x3, float x4) {
+        v = _mm_setr_ps(x1, x2, x3, x4);
+    }
+    static Vector zero() {
+        return Vector(_mm_setzero_ps());
+    }
+    static Vector mask() {
+        return Vector(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_setzero_si128(), _mm_setzero_si128())));
+    }
+    static Vector load(const float* x) {
+        return Vector(_mm_loadu_ps(x));
+    }
+    void store(float* x) {
+        _mm_storeu_ps(x, v);
+    }
+    float& operator[](int i) {
+        return s[i];
+    }
+    const float& operator[](int i) const {
+        return s[i];
+    }
+};
+
+typedef Vector<float, 4> float_4;
+
+#define DECLARE_VECTOR_OPERATOR_INFIX(OP, INSTR) \
+    inline float_4 operator OP(const float_4& a, const float_4& b) { \
+        return float_4(INSTR(a.v, b.v)); \
+    } \
+    inline float_4& operator OP ## =(float_4& a, const float_4& b) { \
+        a = a OP b; \
+        return a; \
+    }
+
+DECLARE_VECTOR_OPERATOR_INFIX(+, _mm_add_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(-, _mm_sub_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(*, _mm_mul_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(/, _mm_div_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(&, _mm_and_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(|, _mm_or_ps)
+DECLARE_VECTOR_OPERATOR_INFIX(^, _mm_xor_ps)
+
+#undef DECLARE_VECTOR_OPERATOR_INFIX
+
+inline float_4 operator==(const float_4& a, const float_4& b) { return float_4(_mm_cmpeq_ps(a.v, b.v)); }
+inline float_4 operator>=(const float_4& a, const float_4& b) { return float_4(_mm_cmpge_ps(a.v, b.v)); }
+inline float_4 operator>(const float_4& a, const float_4& b) { return float_4(_mm_cmpgt_ps(a.v, b.v)); }
+inline float_4 operator<=(const float_4& a, const float_4& b) { return float_4(_mm_cmple_ps(a.v, b.v)); }
+inline float_4 operator<(const float_4& a, const float_4& b) { return float_4(_mm_cmplt_ps(a.v, b.v)); }
+inline float_4 operator!=(const float_4& a, const float_4& b) { return float_4(_mm_cmpneq_ps(a.v, b.v)); }
+inline float_4 operator-(const float_4& a) { return float_4::zero() - a; }
+inline float_4 operator~(const float_4& a) { return a ^ float_4::mask(); }
+
+inline float_4 fmax(float_4 x, float_4 b) { return float_4(_mm_max_ps(x.v, b.v)); }
+inline float_4 fmin(float_4 x, float_4 b) { return float_4(_mm_min_ps(x.v, b.v)); }
+inline float_4 sqrt(float_4 x) { return float_4(_mm_sqrt_ps(x.v)); }
+inline float_4 abs(float_4 x) { return float_4(_mm_andnot_ps(_mm_set1_ps(-0.f), x.v)); }
+inline float_4 clamp(float_4 x, float_4 a, float_4 b) { return fmin(fmax(x, a), b); }
+inline float_4 rescale(float_4 x, float_4 xMin, float_4 xMax, float_4 yMin, float_4 yMax) {
+    return yMin + (x - xMin) / (xMax - xMin) * (yMax - yMin);
+}
+inline float_4 crossfade(float_4 a, float_4 b, float_4 p) { return a + (b - a) * p; }
+inline float_4 ifelse(float_4 mask, float_4 a, float_4 b) {
+    return (a & mask) | float_4(_mm_andnot_ps(mask.v, b.v));
+}
+inline int movemask(float_4 a) { return _mm_movemask_ps(a.v); }
+
+} // namespace simd
+
+namespace dsp {
+
+struct BooleanTrigger {
+    bool state = true;
+    void reset() {
+        state = true;
+    }
+    bool process(bool state) {
+        bool triggered = (state && !this->state);
+        this->state = state;
+        return triggered;
+    }
+};
+
+struct SchmittTrigger {
+    bool state = true;
+    void reset() {
+        state = true;
+    }
+    bool process(float in) {
+        if (state) {
+            if (in <= 0.f) {
+                state = false;
+            }
+        } else {
+            if (in >= 1.f) {
+                state = true;
+                return true;
+            }
+        }
+        return false;
+    }
+    bool isHigh() {
+        return state;
+    }
+};
+
+struct ClockDivider {
+    uint32_t clock = 0;
+    uint32_t division = 1;
+    void reset() {
+        clock = 0;
+    }
+    void setDivision(uint32_t division) {
+        this->division = division;
+    }
+    uint32_t getDivision() {
+        return division;
+    }
+    uint32_t getClock() {
+        return clock;
+    }
+    bool process() {
+        clock++;
+        if (clock >= division) {
+            clock = 0;
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace dsp
+
+namespace engine {
+
+static const int PORT_MAX_CHANNELS = 16;
+
+struct Param {
+    float value = 0.f;
+    float getValue() {
+        return value;
+    }
+    void setValue(float value) {
+        this->value = value;
+    }
+};
+
+struct Port {
+    union {
+        float voltages[PORT_MAX_CHANNELS] = {};
+        float value;
+    };
+    union {
+        uint8_t channels = 0;
+        uint8_t active;
+    };
+
+    void setVoltage(float voltage, int channel = 0) {
+        voltages[channel] = voltage;
+    }
+    float getVoltage(int channel = 0) {
+        return voltages[channel];
+    }
+    float getPolyVoltage(int channel) {
+        return isMonophonic() ? getVoltage(0) : getVoltage(channel);
+    }
+    float getNormalVoltage(float normalVoltage, int channel = 0) {
+        return isConnected() ? getVoltage(channel) : normalVoltage;
+    }
+    float getNormalPolyVoltage(float normalVoltage, int channel) {
+        return isConnected() ? getPolyVoltage(channel) : normalVoltage;
+    }
+    float* getVoltages(int firstChannel = 0) {
+        return &voltages[firstChannel];
+    }
+    float getVoltageSum() {
+        float sum = 0.f;
+        for (int c = 0; c < channels; c++) {
+            sum += voltages[c];
+        }
+        return sum;
+    }
+    template <typename T>
+    T getVoltageSimd(int firstChannel) {
+        return T::load(&voltages[firstChannel]);
+    }
+    template <typename T>
+    T getPolyVoltageSimd(int firstChannel) {
+        return isMonophonic() ? getVoltage(0) : getVoltageSimd<T>(firstChannel);
+    }
+    template <typename T>
+    void setVoltageSimd(T voltage, int firstChannel) {
+        voltage.store(&voltages[firstChannel]);
+    }
+    void setChannels(int channels) {
+        if (this->channels == 0) {
+            return;
+        }
+        for (int c = channels; c < PORT_MAX_CHANNELS; c++) {
+            voltages[c] = 0.f;
+        }
+        if (channels == 0) {
+            channels = 1;
+        }
+        this->channels = channels;
+    }
+    int getChannels() {
+        return channels;
+    }
+    bool isConnected() {
+        return channels > 0;
+    }
+    bool isMonophonic() {
+        return channels == 1;
+    }
+    bool isPolyphonic() {
+        return channels > 1;
+    }
+};
+
+struct Output : Port {};
+
+struct Input : Port {};
+
+struct Light {
+    float value = 0.f;
+    void setBrightness(float brightness) {
+        value = brightness;
+    }
+    float getBrightness() {
+        return value;
+    }
+    void setSmoothBrightness(float brightness, float frames) {
+        value += (brightness - value) / frames;
+    }
+};
+
+struct Module;
+
+struct ParamQuantity {
+    Module* module = NULL;
+    int paramId = 0;
+    float minValue = 0.f;
+    float maxValue = 1.f;
+    float defaultValue = 0.f;
+    std::string label;
+    std::string unit;
+    float displayBase = 0.f;
+    float displayMultiplier = 1.f;
+    float displayOffset = 0.f;
+    virtual ~ParamQuantity() {}
+};
+
+struct Module {
+    int id = -1;
+    std::vector<Param> params;
+    std::vector<Input> inputs;
+    std::vector<Output> outputs;
+    std::vector<Light> lights;
+    std::vector<ParamQuantity*> paramQuantities;
+
+    struct Expander {
+        int moduleId = -1;
+        Module* module = NULL;
+        void* producerMessage = NULL;
+        void* consumerMessage = NULL;
+        bool messageFlipRequested = false;
+    };
+
+    Expander leftExpander;
+    Expander rightExpander;
+    bool bypass = false;
+
+    Module() {}
+    virtual ~Module() {
+        for (ParamQuantity* paramQuantity : paramQuantities) {
+            delete paramQuantity;
+        }
+    }
+
+    void config(int numParams, int numInputs, int numOutputs, int numLights = 0) {
+        params.resize(numParams);
+        inputs.resize(numInputs);
+        outputs.resize(numOutputs);
+        lights.resize(numLights);
+        paramQuantities.resize(numParams);
+        for (int i = 0; i < numParams; i++) {
+            configParam(i, 0.f, 1.f, 0.f);
+        }
+    }
+
+    template <class TParamQuantity = ParamQuantity>
+    void configParam(int paramId, float minValue, float maxValue, float defaultValue,
+                     std::string label = "", std::string unit = "",
+                     float displayBase = 0.f, float displayMultiplier = 1.f,
+                     float displayOffset = 0.f) {
+        if (paramQuantities[paramId]) {
+            delete paramQuantities[paramId];
+        }
+        params[paramId].value = defaultValue;
+
+        ParamQuantity* q = new TParamQuantity;
+        q->module = this;
+        q->paramId = paramId;
+        q->minValue = minValue;
+        q->maxValue = maxValue;
+        q->defaultValue = defaultValue;
+        q->label = label;
+        q->unit = unit;
+        q->displayBase = displayBase;
+        q->displayMultiplier = displayMultiplier;
+        q->displayOffset = displayOffset;
+        paramQuantities[paramId] = q;
+    }
+
+    struct ProcessArgs {
+        float sampleRate;
+        float sampleTime;
+    };
+
+    virtual void process(const ProcessArgs& args) {
+    }
+    virtual json_t* dataToJson() {
+        return NULL;
+    }
+    virtual void dataFromJson(json_t* rootJ) {
+    }
+    virtual void onAdd() {}
+    virtual void onRemove() {}
+    virtual void onReset() {}
+    virtual void onRandomize() {}
+    virtual void onSampleRateChange() {}
+};
+
+} // namespace engine
+
+using namespace math;
+using namespace engine;
+
+struct Plugin;
+struct Model;
+
+inline math::Vec mm2px(math::Vec mm) {
+    return mm.mult(75.f / 25.4f);
+}
+
+} // namespace rack
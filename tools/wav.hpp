@@ -0,0 +1,186 @@
+#pragma once
+// Streaming WAV reader and writer for the headless tools. Reads 16, 24 and
+// 32 bit PCM and 32 bit float, always writes 32 bit float.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+struct WavReader {
+    FILE* file = NULL;
+    int channels = 0;
+    int sampleRate = 0;
+    int bitsPerSample = 0;
+    bool isFloat = false;
+    uint64_t frames = 0;
+    uint64_t framesLeft = 0;
+    std::vector<uint8_t> buffer;
+
+    ~WavReader() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    // Returns an error message, or an empty string.
+    std::string open(const char* path) {
+        file = std::fopen(path, "rb");
+        if (!file) {
+            return std::string("cannot open ") + path;
+        }
+
+        char id[4];
+        uint32_t size;
+        if (!readChunkHeader(id, &size) || std::memcmp(id, "RIFF", 4)) {
+            return "not a RIFF file";
+        }
+        char wave[4];
+        if (std::fread(wave, 1, 4, file) != 4 || std::memcmp(wave, "WAVE", 4)) {
+            return "not a WAVE file";
+        }
+
+        bool hasFormat = false;
+        while (readChunkHeader(id, &size)) {
+            if (!std::memcmp(id, "fmt ", 4)) {
+                uint8_t format[40] = {};
+                if (size < 16 || std::fread(format, 1, std::min<uint32_t>(size, 40), file)
+                        != std::min<uint32_t>(size, 40)) {
+                    return "bad fmt chunk";
+                }
+                if (size > 40) {
+                    std::fseek(file, size - 40, SEEK_CUR);
+                }
+                uint16_t tag = readLe(format, 2);
+                channels = readLe(format + 2, 2);
+                sampleRate = readLe(format + 4, 4);
+                bitsPerSample = readLe(format + 14, 2);
+                // WAVE_FORMAT_EXTENSIBLE: the real tag starts the subformat.
+                if (tag == 0xfffe && size >= 26) {
+                    tag = readLe(format + 24, 2);
+                }
+                isFloat = (tag == 3);
+                if (!(tag == 1 && (bitsPerSample == 16 || bitsPerSample == 24
+                                   || bitsPerSample == 32))
+                        && !(isFloat && bitsPerSample == 32)) {
+                    return "unsupported sample format";
+                }
+                hasFormat = true;
+            } else if (!std::memcmp(id, "data", 4)) {
+                if (!hasFormat || channels == 0) {
+                    return "data before fmt chunk";
+                }
+                frames = size / (channels * (bitsPerSample / 8));
+                framesLeft = frames;
+                return "";
+            } else {
+                std::fseek(file, size + (size & 1), SEEK_CUR);
+            }
+        }
+        return "no data chunk";
+    }
+
+    // Reads up to `count` frames, interleaved, full scale is +/-1.
+    size_t read(float* samples, size_t count) {
+        count = std::min<uint64_t>(count, framesLeft);
+        int bytes = bitsPerSample / 8;
+        buffer.resize(count * channels * bytes);
+        count = std::fread(buffer.data(), channels * bytes, count, file);
+        framesLeft -= count;
+
+        const uint8_t* p = buffer.data();
+        for (size_t i = 0; i < count * channels; i++, p += bytes) {
+            if (isFloat) {
+                std::memcpy(&samples[i], p, 4);
+            } else if (bytes == 2) {
+                samples[i] = (int16_t) readLe(p, 2) / 32768.f;
+            } else if (bytes == 3) {
+                samples[i] = ((int32_t) (readLe(p, 3) << 8) >> 8) / 8388608.f;
+            } else {
+                samples[i] = (int32_t) readLe(p, 4) / 2147483648.f;
+            }
+        }
+        return count;
+    }
+
+    bool readChunkHeader(char* id, uint32_t* size) {
+        uint8_t header[8];
+        if (std::fread(header, 1, 8, file) != 8) {
+            return false;
+        }
+        std::memcpy(id, header, 4);
+        *size = readLe(header + 4, 4);
+        return true;
+    }
+
+    static uint32_t readLe(const uint8_t* p, int bytes) {
+        uint32_t value = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+};
+
+
+struct WavWriter {
+    FILE* file = NULL;
+    int channels = 0;
+    uint64_t frames = 0;
+
+    ~WavWriter() {
+        close();
+    }
+
+    bool open(const char* path, int channels, int sampleRate) {
+        file = std::fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        this->channels = channels;
+        writeHeader(sampleRate);
+        return true;
+    }
+
+    void write(const float* samples, size_t count) {
+        std::fwrite(samples, sizeof(float) * channels, count, file);
+        frames += count;
+    }
+
+    void close() {
+        if (!file) {
+            return;
+        }
+        // Sizes are only known now.
+        uint32_t dataSize = frames * channels * 4;
+        std::fseek(file, 4, SEEK_SET);
+        writeLe(36 + dataSize, 4);
+        std::fseek(file, 40, SEEK_SET);
+        writeLe(dataSize, 4);
+        std::fclose(file);
+        file = NULL;
+    }
+
+    void writeHeader(int sampleRate) {
+        std::fwrite("RIFF", 1, 4, file);
+        writeLe(36, 4);
+        std::fwrite("WAVEfmt ", 1, 8, file);
+        writeLe(16, 4);
+        writeLe(3, 2); // IEEE float
+        writeLe(channels, 2);
+        writeLe(sampleRate, 4);
+        writeLe(sampleRate * channels * 4, 4);
+        writeLe(channels * 4, 2);
+        writeLe(32, 2);
+        std::fwrite("data", 1, 4, file);
+        writeLe(0, 4);
+    }
+
+    void writeLe(uint32_t value, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            std::fputc((value >> (8 * i)) & 0xff, file);
+        }
+    }
+};